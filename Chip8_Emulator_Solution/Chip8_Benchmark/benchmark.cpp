@@ -0,0 +1,432 @@
+// Microbenchmarks of the core: single handlers, dispatch, display packing and whole frames of real ROMs
+#include "../Chip8_Emulator_Project/chip8.h"
+#include "../Chip8_Emulator_Project/scaler.h"
+#include "../Chip8_Emulator_Project/vip_timing.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+//-platform opens an SDL window, only built in with CHIP8_BENCHMARK_PLATFORM so the rest needs no SDL
+#ifdef CHIP8_BENCHMARK_PLATFORM
+#include "../Chip8_Emulator_Project/platform.h"
+#endif
+
+
+/*
+- Every benchmark is timed over several runs of at least run_time each, the fastest run is reported
+  (the other runs only add scheduler and frequency noise)
+- Handler benchmarks execute a buffer of opcodes with randomized operands through Chip8::Execute,
+  on a machine whose registers, I and memory are random, so branches cannot learn the sequence
+- Frame benchmarks run whole 60Hz frames of the ROMs on the command line, with each engine the ROM may use,
+  and through RunFrameTimed with each timing policy (notiming should cost the same as RunFrame)
+- Scale benchmarks turn a random packed display into a 1280x640 RGBA image with each filter
+- -json writes every result for compare.py
+*/
+
+const std::chrono::milliseconds run_time(20);
+const unsigned int runs = 5;
+const unsigned int opcode_count = 4096;
+const unsigned int frame_cycles = 10;
+//1280x640 output
+const unsigned int benchmark_scale = 20;
+
+
+struct Result
+{
+	std::string name;
+	double nanoseconds;
+	uint64_t operations;
+};
+
+//One handler benchmark: opcodes are pattern | (random & operands)
+struct HandlerCase
+{
+	char const* name;
+	uint16_t pattern;
+	uint16_t operands;
+};
+
+static const HandlerCase handler_cases[] = {
+	{ "00E0", 0x00E0, 0x0000 },
+	{ "6xkk", 0x6000, 0x0FFF },
+	{ "7xkk", 0x7000, 0x0FFF },
+	{ "8xy4", 0x8004, 0x0FF0 },
+	{ "Annn", 0xA000, 0x0FFF },
+	{ "Dxy1", 0xD001, 0x0FF0 },
+	{ "Dxy5", 0xD005, 0x0FF0 },
+	{ "DxyF", 0xD00F, 0x0FF0 },
+	{ "Fx1E", 0xF01E, 0x0F00 },
+	{ "Fx33", 0xF033, 0x0F00 },
+	{ "Fx55", 0xF055, 0x0F00 },
+	{ "Fx65", 0xF065, 0x0F00 },
+	//Any opcode at all: every table and sub-table, with the handler changing every instruction
+	{ "dispatch_random", 0x0000, 0xFFFF }
+};
+
+
+//Runs body(iterations) with growing iteration counts until a run takes run_time, returns the best ns per operation
+template <typename Body>
+static Result Measure(std::string const& name, uint64_t operationsPerIteration, Body body)
+{
+	uint64_t iterations = 1;
+	double best = 0.0;
+	uint64_t operations = 0;
+
+	for (unsigned int run = 0; run < runs; )
+	{
+		auto start = std::chrono::steady_clock::now();
+		body(iterations);
+		auto elapsed = std::chrono::steady_clock::now() - start;
+
+		if (elapsed < run_time)
+		{
+			iterations *= 2;
+			continue;
+		}
+
+		double perOperation = std::chrono::duration<double, std::nano>(elapsed).count() / (iterations * operationsPerIteration);
+
+		if (run == 0 || perOperation < best)
+		{
+			best = perOperation;
+		}
+
+		operations += iterations * operationsPerIteration;
+		++run;
+	}
+
+	return Result{ name, best, operations };
+}
+
+//Random memory from 0x200, random registers and I, loaded through the public interface only
+static void Randomize(Chip8& chip8, std::mt19937& random)
+{
+	std::vector<uint8_t> rom(ROM_MAX_SIZE);
+
+	for (uint8_t& byte : rom)
+	{
+		byte = static_cast<uint8_t>(random());
+	}
+
+	chip8.load_ROM(rom.data(), rom.size());
+
+	for (uint16_t reg = 0; reg < REGISTER_COUNT; ++reg)
+	{
+		chip8.Execute(0x6000u | (reg << 8u) | (random() & 0xFFu));
+	}
+
+	chip8.Execute(0xA000u | (random() & 0x0FFFu));
+}
+
+static Result HandlerBenchmark(HandlerCase const& handler, std::mt19937& random)
+{
+	std::vector<Chip8> machine(1);
+	Chip8& chip8 = machine[0];
+	Randomize(chip8, random);
+
+	std::vector<uint16_t> opcodes(opcode_count);
+
+	for (uint16_t& opcode : opcodes)
+	{
+		opcode = handler.pattern | (random() & handler.operands);
+	}
+
+	return Measure(std::string("op_") + handler.name, opcode_count, [&](uint64_t iterations)
+	{
+		for (uint64_t i = 0; i < iterations; ++i)
+		{
+			for (uint16_t opcode : opcodes)
+			{
+				chip8.Execute(opcode);
+			}
+		}
+	});
+}
+
+static Result PackVideoBenchmark(std::mt19937& random)
+{
+	std::vector<Chip8> machine(1);
+	Chip8& chip8 = machine[0];
+
+	for (uint32_t& pixel : chip8.video)
+	{
+		pixel = (random() & 1u) ? 0xFFFFFFFF : 0;
+	}
+
+	uint8_t packed[VIDEO_PACKED_SIZE];
+
+	return Measure("pack_video", 1, [&](uint64_t iterations)
+	{
+		for (uint64_t i = 0; i < iterations; ++i)
+		{
+			chip8.PackVideo(packed);
+			chip8.video[i & (VIDEO_WIDTH * VIDEO_HEIGHT - 1)] ^= packed[i & (VIDEO_PACKED_SIZE - 1)];
+		}
+	});
+}
+
+static Result ScaleBenchmark(ScaleFilter filter, char const* filterName, std::mt19937& random)
+{
+	uint8_t packed[VIDEO_PACKED_SIZE];
+
+	for (uint8_t& byte : packed)
+	{
+		byte = static_cast<uint8_t>(random());
+	}
+
+	ScaleOptions options;
+	options.scale = benchmark_scale;
+	options.filter = filter;
+
+	size_t pitch = static_cast<size_t>(ScaledWidth(options)) * 4;
+	std::vector<uint8_t> image(pitch * ScaledHeight(options));
+
+	return Measure(std::string("scale_") + filterName, 1, [&](uint64_t iterations)
+	{
+		for (uint64_t i = 0; i < iterations; ++i)
+		{
+			ScaleDisplay(packed, options, image.data(), pitch);
+			packed[i & (VIDEO_PACKED_SIZE - 1)] ^= image[i & (image.size() - 1)];
+		}
+	});
+}
+
+//File name without the directories
+static char const* FileName(char const* path)
+{
+	char const* file = path;
+
+	for (char const* c = path; *c; ++c)
+	{
+		if (*c == '/' || *c == '\\')
+		{
+			file = c + 1;
+		}
+	}
+
+	return file;
+}
+
+//Frames of a ROM from the same starting machine every run, keys change every few frames
+template <Engine FrameEngine>
+static Result FrameBenchmark(char const* rom, Chip8 const& start)
+{
+	std::vector<Chip8> machine(1);
+	Chip8& chip8 = machine[0];
+
+	std::string name = std::string("frame_") + EngineName(FrameEngine) + "_" + FileName(rom);
+
+	return Measure(name, 1, [&](uint64_t iterations)
+	{
+		chip8 = start;
+
+		for (uint64_t frame = 0; frame < iterations; ++frame)
+		{
+			chip8.keypad = static_cast<uint16_t>(1u << ((frame / 16) % KEY_COUNT));
+
+			for (unsigned int cycle = 0; cycle < frame_cycles; ++cycle)
+			{
+				switch (FrameEngine)
+				{
+				case ENGINE_PREDECODED:
+					chip8.StepPredecoded();
+					break;
+
+				case ENGINE_CACHED:
+					chip8.StepCached();
+					break;
+
+				default:
+					chip8.Step();
+					break;
+				}
+			}
+
+			chip8.TickTimers();
+		}
+	});
+}
+
+//Same as the frame benchmarks, with the selected engine paced by a timing policy
+template <typename Timing>
+static Result TimedFrameBenchmark(char const* rom, char const* timingName, Chip8 const& start)
+{
+	std::vector<Chip8> machine(1);
+	Chip8& chip8 = machine[0];
+	Timing timing;
+
+	std::string name = std::string("frame_") + timingName + "_" + FileName(rom);
+
+	return Measure(name, 1, [&](uint64_t iterations)
+	{
+		chip8 = start;
+		timing = Timing();
+
+		for (uint64_t frame = 0; frame < iterations; ++frame)
+		{
+			chip8.keypad = static_cast<uint16_t>(1u << ((frame / 16) % KEY_COUNT));
+			chip8.RunFrameTimed(timing, frame_cycles);
+		}
+	});
+}
+
+#ifdef CHIP8_BENCHMARK_PLATFORM
+static Result PlatformBenchmark(std::mt19937& random)
+{
+	Platform platform("CHIP-8 Benchmark", VIDEO_WIDTH * 10, VIDEO_HEIGHT * 10, VIDEO_WIDTH, VIDEO_HEIGHT);
+
+	std::vector<uint32_t> video(VIDEO_WIDTH * VIDEO_HEIGHT);
+
+	for (uint32_t& pixel : video)
+	{
+		pixel = (random() & 1u) ? 0xFFFFFFFF : 0;
+	}
+
+	return Measure("platform_update", 1, [&](uint64_t iterations)
+	{
+		for (uint64_t i = 0; i < iterations; ++i)
+		{
+			platform.Update(video.data(), VIDEO_WIDTH * sizeof(uint32_t));
+		}
+	});
+}
+#endif
+
+//Names are used as JSON strings, only quotes and backslashes need escaping
+static void WriteJson(std::vector<Result> const& results, FILE* file)
+{
+	fprintf(file, "{\n  \"benchmarks\": [\n");
+
+	for (size_t i = 0; i < results.size(); ++i)
+	{
+		std::string name;
+
+		for (char c : results[i].name)
+		{
+			if (c == '"' || c == '\\')
+			{
+				name += '\\';
+			}
+
+			name += c;
+		}
+
+		fprintf(file, "    { \"name\": \"%s\", \"ns_per_op\": %.4f, \"operations\": %llu }%s\n",
+			name.c_str(), results[i].nanoseconds, static_cast<unsigned long long>(results[i].operations),
+			i + 1 < results.size() ? "," : "");
+	}
+
+	fprintf(file, "  ]\n}\n");
+}
+
+
+int main(int argc, char** argv)
+{
+	char const* jsonFilename = nullptr;
+#ifdef CHIP8_BENCHMARK_PLATFORM
+	bool platform = false;
+#endif
+	std::vector<char const*> roms;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "-json") == 0 && i + 1 < argc)
+		{
+			jsonFilename = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "-platform") == 0)
+		{
+#ifdef CHIP8_BENCHMARK_PLATFORM
+			platform = true;
+#else
+			std::cerr << "-platform needs a build with CHIP8_BENCHMARK_PLATFORM (and SDL)\n";
+			std::exit(EXIT_FAILURE);
+#endif
+		}
+		else if (argv[i][0] == '-')
+		{
+			std::cerr << "Usage: " << argv[0] << " [-json <File>] [-platform] [ROM...]\n";
+			std::exit(EXIT_FAILURE);
+		}
+		else
+		{
+			roms.push_back(argv[i]);
+		}
+	}
+
+	//Fixed seed so every run benchmarks the same opcodes and memory
+	std::mt19937 random(0xC8);
+	std::vector<Result> results;
+
+	for (HandlerCase const& handler : handler_cases)
+	{
+		results.push_back(HandlerBenchmark(handler, random));
+	}
+
+	results.push_back(PackVideoBenchmark(random));
+	results.push_back(ScaleBenchmark(SCALE_NEAREST, "nearest", random));
+	results.push_back(ScaleBenchmark(SCALE_SCANLINES, "scanlines", random));
+	results.push_back(ScaleBenchmark(SCALE_GRID, "grid", random));
+
+	for (char const* rom : roms)
+	{
+		std::vector<Chip8> start(1);
+
+		if (!start[0].open_ROM(rom))
+		{
+			std::cerr << "Could not load ROM: " << rom << "\n";
+			std::exit(EXIT_FAILURE);
+		}
+
+		//Benchmark the game rather than its first frames of setup
+		for (unsigned int frame = 0; frame < 60; ++frame)
+		{
+			start[0].RunFrame(frame_cycles);
+		}
+
+		results.push_back(FrameBenchmark<ENGINE_INTERPRETER>(rom, start[0]));
+		results.push_back(FrameBenchmark<ENGINE_CACHED>(rom, start[0]));
+
+		//Only correct when the analysis allows it
+		if (start[0].SelectedEngine() == ENGINE_PREDECODED)
+		{
+			results.push_back(FrameBenchmark<ENGINE_PREDECODED>(rom, start[0]));
+		}
+
+		results.push_back(TimedFrameBenchmark<NoTiming>(rom, "notiming", start[0]));
+		results.push_back(TimedFrameBenchmark<VipTiming>(rom, "vip", start[0]));
+	}
+
+#ifdef CHIP8_BENCHMARK_PLATFORM
+	if (platform)
+	{
+		results.push_back(PlatformBenchmark(random));
+	}
+#endif
+
+	for (Result const& result : results)
+	{
+		printf("%-40s %12.2f ns\n", result.name.c_str(), result.nanoseconds);
+	}
+
+	if (jsonFilename)
+	{
+		FILE* file = fopen(jsonFilename, "w");
+
+		if (!file)
+		{
+			std::cerr << "Could not write " << jsonFilename << "\n";
+			std::exit(EXIT_FAILURE);
+		}
+
+		WriteJson(results, file);
+		fclose(file);
+	}
+
+	return 0;
+}
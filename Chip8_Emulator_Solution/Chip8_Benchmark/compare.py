@@ -0,0 +1,57 @@
+#!/usr/bin/env python3
+# Compares two Chip8_Benchmark -json files and flags benchmarks that got slower than the threshold
+# Usage: compare.py <Baseline.json> <Current.json> [Threshold percent, default 5]
+# Exits with 1 when any benchmark regressed, so it can gate a change
+import json
+import sys
+
+
+def load(path):
+    with open(path) as file:
+        return {entry["name"]: entry["ns_per_op"] for entry in json.load(file)["benchmarks"]}
+
+
+def main():
+    if len(sys.argv) < 3:
+        print("Usage: compare.py <Baseline.json> <Current.json> [Threshold percent]", file=sys.stderr)
+        return 2
+
+    baseline = load(sys.argv[1])
+    current = load(sys.argv[2])
+    threshold = float(sys.argv[3]) if len(sys.argv) > 3 else 5.0
+
+    regressions = 0
+    width = max((len(name) for name in baseline.keys() | current.keys()), default=0)
+
+    for name in sorted(baseline.keys() | current.keys()):
+        if name not in current:
+            print(f"{name:<{width}}  only in baseline")
+            continue
+
+        if name not in baseline:
+            print(f"{name:<{width}}  new: {current[name]:.2f} ns")
+            continue
+
+        before = baseline[name]
+        after = current[name]
+        change = (after - before) / before * 100.0 if before > 0 else 0.0
+
+        flag = ""
+
+        if change > threshold:
+            flag = "  REGRESSION"
+            regressions += 1
+        elif change < -threshold:
+            flag = "  faster"
+
+        print(f"{name:<{width}}  {before:10.2f} ns -> {after:10.2f} ns  {change:+7.1f}%{flag}")
+
+    if regressions:
+        print(f"{regressions} benchmark(s) slower by more than {threshold}%")
+        return 1
+
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,682 @@
+// Executes every opcode from generated machine states on each execution backend and checks the result
+// against a reference model of the instruction set and, optionally, recorded golden vectors
+#include "../Chip8_Emulator_Project/chip8.h"
+#include "../Chip8_Emulator_Project/rom_cache.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+/*
+- Cases are generated from a seed: a batch of cases shares one random ROM image (so the pre-decoded backends
+  see the instruction in their decoded tables), each case has its own opcode at its own address and random
+  registers, I, stack, timers, display and keys
+- The reference model below is written from the instruction descriptions, not from the handlers:
+	flags of 8xy4 - 8xyE are written after the result, 8xy5/8xy7 set VF when there is no borrow (>=),
+	8xy6/8xyE shift Vx, Fx55/Fx65 leave I alone, Fx29 uses the low nibble of Vx,
+	Dxyn clips at the edges, addresses wrap inside 4KB and the stack pointer inside 16 levels
+- A golden vector is the hash of the state the reference reached for a case; -record writes them and -golden checks
+  a run against a recorded file, so a change to the reference itself is caught too
+- golden_v1.txt (default seed and case count) is committed next to this file and checked by a run without options;
+  it is looked for next to the executable, next to this source file and in the working directory
+*/
+
+const unsigned int cases_per_image = 32;
+const unsigned int default_cases = 20000;
+const unsigned int max_reported = 20;
+const unsigned int golden_version = 1;
+const char default_golden_file[] = "golden_v1.txt";
+//Where the fonts are loaded, 5 bytes per digit
+const uint16_t font_address = 0x50;
+
+//One case per instruction in turn: opcodes are pattern | (random & operands)
+struct OpcodeCase
+{
+	Instruction instruction;
+	uint16_t pattern;
+	uint16_t operands;
+};
+
+static const OpcodeCase opcode_cases[] = {
+	{ INSTRUCTION_00E0, 0x00E0, 0x0000 },
+	{ INSTRUCTION_00EE, 0x00EE, 0x0000 },
+	{ INSTRUCTION_1nnn, 0x1000, 0x0FFF },
+	{ INSTRUCTION_2nnn, 0x2000, 0x0FFF },
+	{ INSTRUCTION_3xkk, 0x3000, 0x0FFF },
+	{ INSTRUCTION_4xkk, 0x4000, 0x0FFF },
+	{ INSTRUCTION_5xy0, 0x5000, 0x0FF0 },
+	{ INSTRUCTION_6xkk, 0x6000, 0x0FFF },
+	{ INSTRUCTION_7xkk, 0x7000, 0x0FFF },
+	{ INSTRUCTION_8xy0, 0x8000, 0x0FF0 },
+	{ INSTRUCTION_8xy1, 0x8001, 0x0FF0 },
+	{ INSTRUCTION_8xy2, 0x8002, 0x0FF0 },
+	{ INSTRUCTION_8xy3, 0x8003, 0x0FF0 },
+	{ INSTRUCTION_8xy4, 0x8004, 0x0FF0 },
+	{ INSTRUCTION_8xy5, 0x8005, 0x0FF0 },
+	{ INSTRUCTION_8xy6, 0x8006, 0x0FF0 },
+	{ INSTRUCTION_8xy7, 0x8007, 0x0FF0 },
+	{ INSTRUCTION_8xyE, 0x800E, 0x0FF0 },
+	{ INSTRUCTION_9xy0, 0x9000, 0x0FF0 },
+	{ INSTRUCTION_Annn, 0xA000, 0x0FFF },
+	{ INSTRUCTION_Bnnn, 0xB000, 0x0FFF },
+	{ INSTRUCTION_Cxkk, 0xC000, 0x0FFF },
+	{ INSTRUCTION_Dxyn, 0xD000, 0x0FFF },
+	{ INSTRUCTION_Ex9E, 0xE09E, 0x0F00 },
+	{ INSTRUCTION_ExA1, 0xE0A1, 0x0F00 },
+	{ INSTRUCTION_Fx07, 0xF007, 0x0F00 },
+	{ INSTRUCTION_Fx0A, 0xF00A, 0x0F00 },
+	{ INSTRUCTION_Fx15, 0xF015, 0x0F00 },
+	{ INSTRUCTION_Fx18, 0xF018, 0x0F00 },
+	{ INSTRUCTION_Fx1E, 0xF01E, 0x0F00 },
+	{ INSTRUCTION_Fx29, 0xF029, 0x0F00 },
+	{ INSTRUCTION_Fx33, 0xF033, 0x0F00 },
+	{ INSTRUCTION_Fx55, 0xF055, 0x0F00 },
+	{ INSTRUCTION_Fx65, 0xF065, 0x0F00 }
+};
+
+const unsigned int opcode_case_count = sizeof(opcode_cases) / sizeof(opcode_cases[0]);
+
+enum Backend
+{
+	BACKEND_INTERPRETER,
+	BACKEND_CACHED,
+	BACKEND_PREDECODED,
+	BACKEND_HOOKED,
+	BACKEND_COUNT
+};
+
+static char const* const backend_names[BACKEND_COUNT] = { "interpreter", "cached", "predecoded", "hooked" };
+
+//Everything an instruction can change
+struct State
+{
+	uint8_t v[REGISTER_COUNT];
+	uint16_t i;
+	uint16_t pc;
+	uint8_t sp;
+	uint8_t dt;
+	uint8_t st;
+	uint16_t stack[STACK_LEVELS];
+	uint8_t memory[MEMORY_SIZE];
+	//One byte per pixel, 0 or 1
+	uint8_t video[VIDEO_WIDTH * VIDEO_HEIGHT];
+};
+
+//Hooks that do something, so the hooked path is not the NoHooks instantiation Step already uses
+struct CountingHooks
+{
+	uint64_t count{};
+
+	bool BeforeExecute(Chip8 const&, uint16_t, uint16_t)
+	{
+		++count;
+		return true;
+	}
+};
+
+struct Options
+{
+	uint64_t seed{ 1 };
+	uint64_t cases{ default_cases };
+	char const* recordFilename{};
+	char const* goldenFilename{};
+	//-seed, -cases or -record given, or -nogolden: no default golden file
+	bool customRun{};
+};
+
+
+//splitmix64, the whole generator is defined here so cases are the same on every platform
+static uint64_t NextRandom(uint64_t& state)
+{
+	uint64_t value = (state += 0x9E3779B97F4A7C15ull);
+	value = (value ^ (value >> 30u)) * 0xBF58476D1CE4E5B9ull;
+	value = (value ^ (value >> 27u)) * 0x94D049BB133111EBull;
+	return value ^ (value >> 31u);
+}
+
+static void ReadState(Chip8 const& chip8, State& state)
+{
+	Chip8Registers registers;
+	chip8.GetRegisters(registers);
+
+	//Padding too, states are compared with memcmp
+	memset(&state, 0, sizeof(state));
+	memcpy(state.v, registers.registers, sizeof(state.v));
+	state.i = registers.index_register;
+	state.pc = registers.program_counter;
+	state.sp = registers.stack_pointer;
+	state.dt = registers.delay_timer;
+	state.st = registers.sound_timer;
+	memcpy(state.stack, registers.stack, sizeof(state.stack));
+	memcpy(state.memory, chip8.Memory(), sizeof(state.memory));
+
+	for (unsigned int pixel = 0; pixel < VIDEO_WIDTH * VIDEO_HEIGHT; ++pixel)
+	{
+		state.video[pixel] = chip8.video[pixel] != 0;
+	}
+}
+
+//The instruction at state.pc, executed as described at the top. random is the byte Cxkk draws
+static void ReferenceStep(State& s, uint16_t keys, uint8_t random)
+{
+	s.pc &= MEMORY_SIZE - 1;
+	uint16_t opcode = (s.memory[s.pc] << 8u) | s.memory[(s.pc + 1) & (MEMORY_SIZE - 1)];
+	s.pc += 2;
+
+	unsigned int x = (opcode >> 8u) & 0xFu;
+	unsigned int y = (opcode >> 4u) & 0xFu;
+	uint8_t kk = opcode & 0xFFu;
+	uint16_t nnn = opcode & 0x0FFFu;
+	uint8_t vx = s.v[x];
+	uint8_t vy = s.v[y];
+
+	switch (DecodeInstruction(opcode))
+	{
+	case INSTRUCTION_00E0: memset(s.video, 0, sizeof(s.video)); break;
+	case INSTRUCTION_00EE: s.sp = (s.sp - 1) & (STACK_LEVELS - 1); s.pc = s.stack[s.sp]; break;
+	case INSTRUCTION_1nnn: s.pc = nnn; break;
+	case INSTRUCTION_2nnn: s.stack[s.sp] = s.pc; s.sp = (s.sp + 1) & (STACK_LEVELS - 1); s.pc = nnn; break;
+	case INSTRUCTION_3xkk: s.pc += vx == kk ? 2 : 0; break;
+	case INSTRUCTION_4xkk: s.pc += vx != kk ? 2 : 0; break;
+	case INSTRUCTION_5xy0: s.pc += vx == vy ? 2 : 0; break;
+	case INSTRUCTION_6xkk: s.v[x] = kk; break;
+	case INSTRUCTION_7xkk: s.v[x] = vx + kk; break;
+	case INSTRUCTION_8xy0: s.v[x] = vy; break;
+	case INSTRUCTION_8xy1: s.v[x] = vx | vy; break;
+	case INSTRUCTION_8xy2: s.v[x] = vx & vy; break;
+	case INSTRUCTION_8xy3: s.v[x] = vx ^ vy; break;
+	case INSTRUCTION_8xy4: s.v[x] = vx + vy; s.v[0xF] = vx + vy > 0xFF; break;
+	case INSTRUCTION_8xy5: s.v[x] = vx - vy; s.v[0xF] = vx >= vy; break;
+	case INSTRUCTION_8xy6: s.v[x] = vx >> 1u; s.v[0xF] = vx & 1u; break;
+	case INSTRUCTION_8xy7: s.v[x] = vy - vx; s.v[0xF] = vy >= vx; break;
+	case INSTRUCTION_8xyE: s.v[x] = vx << 1u; s.v[0xF] = vx >> 7u; break;
+	case INSTRUCTION_9xy0: s.pc += vx != vy ? 2 : 0; break;
+	case INSTRUCTION_Annn: s.i = nnn; break;
+	case INSTRUCTION_Bnnn: s.pc = s.v[0] + nnn; break;
+	case INSTRUCTION_Cxkk: s.v[x] = random & kk; break;
+
+	case INSTRUCTION_Dxyn:
+	{
+		unsigned int left = vx % VIDEO_WIDTH;
+		unsigned int top = vy % VIDEO_HEIGHT;
+		uint8_t collision = 0;
+
+		for (unsigned int row = 0; row < (opcode & 0xFu) && top + row < VIDEO_HEIGHT; ++row)
+		{
+			uint8_t bits = s.memory[(s.i + row) & (MEMORY_SIZE - 1)];
+
+			for (unsigned int col = 0; col < 8 && left + col < VIDEO_WIDTH; ++col)
+			{
+				if (bits & (0x80u >> col))
+				{
+					uint8_t& pixel = s.video[(top + row) * VIDEO_WIDTH + left + col];
+					collision |= pixel;
+					pixel ^= 1u;
+				}
+			}
+		}
+
+		s.v[0xF] = collision;
+		break;
+	}
+
+	case INSTRUCTION_Ex9E: s.pc += (keys >> (vx & 0xFu)) & 1u ? 2 : 0; break;
+	case INSTRUCTION_ExA1: s.pc += (keys >> (vx & 0xFu)) & 1u ? 0 : 2; break;
+	case INSTRUCTION_Fx07: s.v[x] = s.dt; break;
+
+	case INSTRUCTION_Fx0A:
+		if (keys == 0)
+		{
+			s.pc -= 2;
+		}
+		else
+		{
+			uint8_t key = 0;
+
+			while (!((keys >> key) & 1u))
+			{
+				++key;
+			}
+
+			s.v[x] = key;
+		}
+		break;
+
+	case INSTRUCTION_Fx15: s.dt = vx; break;
+	case INSTRUCTION_Fx18: s.st = vx; break;
+	case INSTRUCTION_Fx1E: s.i += vx; break;
+	case INSTRUCTION_Fx29: s.i = font_address + 5 * (vx & 0xFu); break;
+
+	case INSTRUCTION_Fx33:
+		s.memory[s.i & (MEMORY_SIZE - 1)] = vx / 100;
+		s.memory[(s.i + 1) & (MEMORY_SIZE - 1)] = (vx / 10) % 10;
+		s.memory[(s.i + 2) & (MEMORY_SIZE - 1)] = vx % 10;
+		break;
+
+	case INSTRUCTION_Fx55:
+		for (unsigned int r = 0; r <= x; ++r)
+		{
+			s.memory[(s.i + r) & (MEMORY_SIZE - 1)] = s.v[r];
+		}
+		break;
+
+	case INSTRUCTION_Fx65:
+		for (unsigned int r = 0; r <= x; ++r)
+		{
+			s.v[r] = s.memory[(s.i + r) & (MEMORY_SIZE - 1)];
+		}
+		break;
+
+	default:
+		break;
+	}
+}
+
+static void Step(Chip8& chip8, Backend backend)
+{
+	CountingHooks hooks;
+
+	switch (backend)
+	{
+	case BACKEND_CACHED:
+		chip8.StepCached();
+		break;
+
+	case BACKEND_PREDECODED:
+		chip8.StepPredecoded();
+		break;
+
+	case BACKEND_HOOKED:
+		chip8.StepHooked(hooks);
+		break;
+
+	default:
+		chip8.Step();
+		break;
+	}
+}
+
+static uint64_t HashState(State const& state)
+{
+	//Fields hashed one by one, so padding never takes part
+	uint64_t hash = HashRom(state.v, sizeof(state.v));
+	uint16_t words[3] = { state.i, state.pc, uint16_t(state.sp | (state.dt << 8u)) };
+
+	hash ^= HashRom(reinterpret_cast<uint8_t const*>(words), sizeof(words)) * 3;
+	hash ^= HashRom(reinterpret_cast<uint8_t const*>(state.stack), sizeof(state.stack)) * 5;
+	hash ^= HashRom(state.memory, sizeof(state.memory)) * 7;
+	hash ^= HashRom(state.video, sizeof(state.video)) * 11;
+	hash ^= uint64_t(state.st) * 13;
+
+	return hash;
+}
+
+//Differences between the reference and a backend, one line each
+static void PrintDifferences(State const& expected, State const& actual, std::ostream& out)
+{
+	for (unsigned int r = 0; r < REGISTER_COUNT; ++r)
+	{
+		if (expected.v[r] != actual.v[r])
+		{
+			out << "    V" << std::hex << std::uppercase << r << ": expected 0x" << unsigned(expected.v[r])
+				<< " got 0x" << unsigned(actual.v[r]) << std::dec << std::nouppercase << "\n";
+		}
+	}
+
+	auto field = [&](char const* name, unsigned int want, unsigned int got)
+	{
+		if (want != got)
+		{
+			out << "    " << name << ": expected 0x" << std::hex << want << " got 0x" << got << std::dec << "\n";
+		}
+	};
+
+	field("I", expected.i, actual.i);
+	field("PC", expected.pc, actual.pc);
+	field("SP", expected.sp, actual.sp);
+	field("DT", expected.dt, actual.dt);
+	field("ST", expected.st, actual.st);
+
+	for (unsigned int level = 0; level < STACK_LEVELS; ++level)
+	{
+		field("stack", expected.stack[level], actual.stack[level]);
+	}
+
+	for (unsigned int address = 0; address < MEMORY_SIZE; ++address)
+	{
+		if (expected.memory[address] != actual.memory[address])
+		{
+			out << "    memory[0x" << std::hex << address << "]: expected 0x" << unsigned(expected.memory[address])
+				<< " got 0x" << unsigned(actual.memory[address]) << std::dec << "\n";
+		}
+	}
+
+	unsigned int pixels = 0;
+
+	for (unsigned int pixel = 0; pixel < VIDEO_WIDTH * VIDEO_HEIGHT; ++pixel)
+	{
+		pixels += expected.video[pixel] != actual.video[pixel];
+	}
+
+	if (pixels)
+	{
+		out << "    " << pixels << " pixels differ\n";
+	}
+}
+
+static std::string Directory(std::string const& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+//Empty if the committed file is found nowhere
+static std::string FindDefaultGolden(char const* executable)
+{
+	std::string candidates[] = {
+		Directory(executable) + default_golden_file,
+		Directory(__FILE__) + default_golden_file,
+		default_golden_file
+	};
+
+	for (std::string const& candidate : candidates)
+	{
+		if (FILE* file = fopen(candidate.c_str(), "r"))
+		{
+			fclose(file);
+			return candidate;
+		}
+	}
+
+	return std::string();
+}
+
+static bool ReadGolden(char const* file_name, Options& options, std::vector<uint64_t>& golden)
+{
+	FILE* file = fopen(file_name, "r");
+
+	if (!file)
+	{
+		return false;
+	}
+
+	unsigned int version;
+	unsigned long long seed, cases;
+	bool ok = fscanf(file, "chip8-conformance %u %llu %llu", &version, &seed, &cases) == 3 && version == golden_version;
+
+	if (ok)
+	{
+		options.seed = seed;
+		options.cases = cases;
+		golden.resize(cases);
+
+		for (unsigned long long index = 0; index < cases && ok; ++index)
+		{
+			unsigned long long line, hash;
+			unsigned int opcode;
+			ok = fscanf(file, "%llu %x %llx", &line, &opcode, &hash) == 3 && line == index;
+			golden[index] = hash;
+		}
+	}
+
+	fclose(file);
+
+	return ok;
+}
+
+
+int main(int argc, char** argv)
+{
+	Options options;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		bool hasValue = i + 1 < argc;
+
+		if (std::strcmp(argv[i], "-cases") == 0 && hasValue)
+		{
+			options.cases = std::strtoull(argv[++i], nullptr, 10);
+			options.customRun = true;
+		}
+		else if (std::strcmp(argv[i], "-seed") == 0 && hasValue)
+		{
+			options.seed = std::strtoull(argv[++i], nullptr, 10);
+			options.customRun = true;
+		}
+		else if (std::strcmp(argv[i], "-record") == 0 && hasValue)
+		{
+			options.recordFilename = argv[++i];
+			options.customRun = true;
+		}
+		else if (std::strcmp(argv[i], "-golden") == 0 && hasValue)
+		{
+			options.goldenFilename = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "-nogolden") == 0)
+		{
+			options.customRun = true;
+		}
+		else
+		{
+			std::cerr << "Usage: " << argv[0] << " [-cases <N>] [-seed <N>] [-record <Golden File>] [-golden <Golden File>] [-nogolden]\n";
+			std::exit(EXIT_FAILURE);
+		}
+	}
+
+	std::string defaultGolden;
+
+	if (!options.goldenFilename && !options.customRun)
+	{
+		defaultGolden = FindDefaultGolden(argv[0]);
+
+		if (defaultGolden.empty())
+		{
+			std::cerr << "Could not find " << default_golden_file << ", pass it with -golden or run with -nogolden\n";
+			std::exit(EXIT_FAILURE);
+		}
+
+		options.goldenFilename = defaultGolden.c_str();
+	}
+
+	std::vector<uint64_t> golden;
+
+	if (options.goldenFilename && !ReadGolden(options.goldenFilename, options, golden))
+	{
+		std::cerr << "Not a golden vector file: " << options.goldenFilename << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	FILE* record = nullptr;
+
+	if (options.recordFilename)
+	{
+		record = fopen(options.recordFilename, "w");
+
+		if (!record)
+		{
+			std::cerr << "Could not open golden vector file: " << options.recordFilename << "\n";
+			std::exit(EXIT_FAILURE);
+		}
+
+		fprintf(record, "chip8-conformance %u %llu %llu\n", golden_version,
+			static_cast<unsigned long long>(options.seed), static_cast<unsigned long long>(options.cases));
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	//Machines and states are kept off the stack, a Chip8 is about 12KB
+	std::unique_ptr<Chip8[]> machines(new Chip8[3]);
+	Chip8& base = machines[0];
+	Chip8& initial = machines[1];
+	Chip8& machine = machines[2];
+	std::unique_ptr<State[]> states(new State[2]);
+	State& expected = states[0];
+	State& actual = states[1];
+
+	uint64_t failures[opcode_case_count]{};
+	uint64_t goldenFailures = 0;
+	uint64_t reported = 0;
+	std::vector<uint8_t> rom(ROM_MAX_SIZE);
+	std::vector<uint16_t> addresses(cases_per_image);
+
+	for (uint64_t first = 0; first < options.cases; first += cases_per_image)
+	{
+		uint64_t random = options.seed * 0x100000001B3ull ^ first;
+
+		for (uint8_t& byte : rom)
+		{
+			byte = static_cast<uint8_t>(NextRandom(random));
+		}
+
+		uint64_t count = options.cases - first < cases_per_image ? options.cases - first : cases_per_image;
+
+		//Distinct even addresses, so no two opcodes overlap
+		for (uint64_t k = 0; k < count; ++k)
+		{
+			bool taken;
+
+			do
+			{
+				addresses[k] = static_cast<uint16_t>(ROM_START_ADDRESS + (NextRandom(random) % (ROM_MAX_SIZE / 2)) * 2);
+				taken = false;
+
+				for (uint64_t other = 0; other < k; ++other)
+				{
+					taken |= addresses[other] == addresses[k];
+				}
+			} while (taken);
+
+			OpcodeCase const& opcodeCase = opcode_cases[(first + k) % opcode_case_count];
+			uint16_t opcode = opcodeCase.pattern | (NextRandom(random) & opcodeCase.operands);
+			rom[addresses[k] - ROM_START_ADDRESS] = static_cast<uint8_t>(opcode >> 8u);
+			rom[addresses[k] - ROM_START_ADDRESS + 1] = static_cast<uint8_t>(opcode);
+		}
+
+		//The machines of the last batch are overwritten from base, so its image is no longer used
+		RomImage const* previousImage = base.Image();
+		base.load_ROM(*CacheRomImage(rom.data(), rom.size()));
+		ReleaseRomImage(previousImage);
+
+		for (uint64_t k = 0; k < count; ++k)
+		{
+			uint64_t index = first + k;
+			unsigned int caseNumber = static_cast<unsigned int>(index % opcode_case_count);
+
+			Chip8Registers registers;
+
+			for (uint8_t& value : registers.registers)
+			{
+				value = static_cast<uint8_t>(NextRandom(random));
+			}
+
+			for (uint16_t& level : registers.stack)
+			{
+				level = static_cast<uint16_t>(NextRandom(random) & 0xFFFu);
+			}
+
+			uint64_t bits = NextRandom(random);
+			//Mostly inside memory, sometimes right at its end so reads and writes wrap
+			registers.index_register = (bits & 7u) == 0 ? static_cast<uint16_t>(0xFFD + ((bits >> 3u) & 3u)) : static_cast<uint16_t>((bits >> 8u) & 0xFFFu);
+			registers.delay_timer = static_cast<uint8_t>(bits >> 20u);
+			registers.sound_timer = static_cast<uint8_t>(bits >> 28u);
+			registers.stack_pointer = static_cast<uint8_t>((bits >> 36u) & 0xFu);
+			registers.program_counter = addresses[k];
+			registers.opcode = 0;
+
+			initial = base;
+			initial.SetRegisters(registers);
+			initial.Seed(index);
+			//No key a quarter of the time, so Fx0A also waits
+			initial.keypad = (bits >> 40u) & 3u ? static_cast<uint16_t>(NextRandom(random)) : 0;
+
+			uint64_t pixels = 0;
+
+			for (unsigned int pixel = 0; pixel < VIDEO_WIDTH * VIDEO_HEIGHT; ++pixel)
+			{
+				if (pixel % 64 == 0)
+				{
+					pixels = NextRandom(random);
+				}
+
+				initial.video[pixel] = (pixels >> (pixel % 64)) & 1u ? 0xFFFFFFFF : 0;
+			}
+
+			//The byte Cxkk draws on a machine with this seed
+			machine = initial;
+			machine.Execute(0xC0FF);
+			uint8_t randomByte = machine.Register(0);
+
+			ReadState(initial, expected);
+			ReferenceStep(expected, initial.keypad, randomByte);
+
+			uint64_t hash = HashState(expected);
+
+			if (record)
+			{
+				fprintf(record, "%llu %04X %016llX\n", static_cast<unsigned long long>(index), initial.NextOpcode(),
+					static_cast<unsigned long long>(hash));
+			}
+
+			if (!golden.empty() && golden[index] != hash)
+			{
+				++goldenFailures;
+
+				if (reported++ < max_reported)
+				{
+					std::cout << "case " << index << ": " << InstructionName(opcode_cases[caseNumber].instruction)
+						<< " reference does not match the golden vector\n";
+				}
+			}
+
+			for (unsigned int backend = 0; backend < BACKEND_COUNT; ++backend)
+			{
+				machine = initial;
+				Step(machine, static_cast<Backend>(backend));
+				ReadState(machine, actual);
+
+				if (memcmp(&expected, &actual, sizeof(State)) == 0)
+				{
+					continue;
+				}
+
+				++failures[caseNumber];
+
+				if (reported++ < max_reported)
+				{
+					std::cout << "case " << index << ": " << InstructionName(opcode_cases[caseNumber].instruction) << " opcode 0x"
+						<< std::hex << initial.NextOpcode() << " at 0x" << addresses[k] << std::dec << " on "
+						<< backend_names[backend] << "\n";
+					PrintDifferences(expected, actual, std::cout);
+				}
+			}
+		}
+	}
+
+	if (record)
+	{
+		fclose(record);
+	}
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	uint64_t total = goldenFailures;
+
+	for (unsigned int caseNumber = 0; caseNumber < opcode_case_count; ++caseNumber)
+	{
+		if (failures[caseNumber])
+		{
+			std::cout << InstructionName(opcode_cases[caseNumber].instruction) << ": " << failures[caseNumber] << " failures\n";
+		}
+
+		total += failures[caseNumber];
+	}
+
+	std::cout << options.cases << " cases x " << BACKEND_COUNT << " backends (" << opcode_case_count << " opcodes) in "
+		<< seconds << " s, " << total << " failures" << (golden.empty() ? "" : ", checked against golden vectors") << "\n";
+
+	return total ? EXIT_FAILURE : EXIT_SUCCESS;
+}
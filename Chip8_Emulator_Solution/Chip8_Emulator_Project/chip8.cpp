@@ -1,14 +1,46 @@
 #include "chip8.h"
+#include "heatmap.h"
+#include "rom_cache.h"
 #include <chrono>
 #include <cstdint>
 #include <cstring>
-#include <fstream>
 #include <random>
 
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
 //FUnction to load the contents of a ROM file to save the instructions in memory
 
 //Store insturctions to memory as stated in chip8.h (starts at 0x200)
-const unsigned int start_mem = 0x200;
+const unsigned int start_mem = ROM_START_ADDRESS;
+
+//ROMs are untrusted: every address computed from registers wraps inside the 4KB of memory
+//and the stack pointer wraps inside the 16 levels, so a bad ROM can only corrupt its own machine
+const unsigned int memory_mask = MEMORY_SIZE - 1;
+const unsigned int stack_mask = STACK_LEVELS - 1;
+
+const uint64_t default_random_seed = 0x43484950382D3031ull;
+
+//Pixel keys come after every memory key, so a pixel key never equals the key of a byte of memory
+const uint64_t pixel_key_base = uint64_t(MEMORY_SIZE) << 8u;
+static uint64_t pixel_keys[VIDEO_WIDTH * VIDEO_HEIGHT];
+
+//splitmix64 finalizer: a bijection, so distinct inputs give distinct keys
+static uint64_t MixKey(uint64_t value)
+{
+	value ^= value >> 30u;
+	value *= 0xBF58476D1CE4E5B9ull;
+	value ^= value >> 27u;
+	value *= 0x94D049BB133111EBull;
+	value ^= value >> 31u;
+	return value;
+}
+
+static uint64_t MemoryKey(unsigned int address, uint8_t value)
+{
+	return MixKey((uint64_t(address) << 8u) | value);
+}
 
 //A ROM expects 16 characters at a certain locaiton to write characters onto screen
 // Putting these characters into memory
@@ -42,6 +74,100 @@ uint8_t fonts[num_of_fonts] = {
 };
 
 
+Chip8::Chip8Func const Chip8::instruction_table[INSTRUCTION_COUNT] = {
+	&Chip8::OP_NULL,
+	&Chip8::OP_00E0, &Chip8::OP_00EE, &Chip8::OP_1nnn, &Chip8::OP_2nnn,
+	&Chip8::OP_3xkk, &Chip8::OP_4xkk, &Chip8::OP_5xy0, &Chip8::OP_6xkk, &Chip8::OP_7xkk,
+	&Chip8::OP_8xy0, &Chip8::OP_8xy1, &Chip8::OP_8xy2, &Chip8::OP_8xy3, &Chip8::OP_8xy4,
+	&Chip8::OP_8xy5, &Chip8::OP_8xy6, &Chip8::OP_8xy7, &Chip8::OP_8xyE, &Chip8::OP_9xy0,
+	&Chip8::OP_Annn, &Chip8::OP_Bnnn, &Chip8::OP_Cxkk, &Chip8::OP_Dxyn,
+	&Chip8::OP_Ex9E, &Chip8::OP_ExA1,
+	&Chip8::OP_Fx07, &Chip8::OP_Fx0A, &Chip8::OP_Fx15, &Chip8::OP_Fx18, &Chip8::OP_Fx1E,
+	&Chip8::OP_Fx29, &Chip8::OP_Fx33, &Chip8::OP_Fx55, &Chip8::OP_Fx65
+};
+
+static char const* const instruction_names[INSTRUCTION_COUNT] = {
+	"NULL",
+	"00E0", "00EE", "1nnn", "2nnn", "3xkk", "4xkk", "5xy0", "6xkk", "7xkk",
+	"8xy0", "8xy1", "8xy2", "8xy3", "8xy4", "8xy5", "8xy6", "8xy7", "8xyE", "9xy0",
+	"Annn", "Bnnn", "Cxkk", "Dxyn", "Ex9E", "ExA1",
+	"Fx07", "Fx0A", "Fx15", "Fx18", "Fx1E", "Fx29", "Fx33", "Fx55", "Fx65"
+};
+
+//Mirrors the function pointer tables, including which low nibbles/bytes fall through to OP_NULL
+Instruction DecodeInstruction(uint16_t opcode)
+{
+	switch (opcode >> 12u)
+	{
+	case 0x0:
+		switch (opcode & 0x000Fu)
+		{
+		case 0x0: return INSTRUCTION_00E0;
+		case 0xE: return INSTRUCTION_00EE;
+		default: return INSTRUCTION_NULL;
+		}
+	case 0x1: return INSTRUCTION_1nnn;
+	case 0x2: return INSTRUCTION_2nnn;
+	case 0x3: return INSTRUCTION_3xkk;
+	case 0x4: return INSTRUCTION_4xkk;
+	case 0x5: return INSTRUCTION_5xy0;
+	case 0x6: return INSTRUCTION_6xkk;
+	case 0x7: return INSTRUCTION_7xkk;
+	case 0x8:
+		switch (opcode & 0x000Fu)
+		{
+		case 0x0: return INSTRUCTION_8xy0;
+		case 0x1: return INSTRUCTION_8xy1;
+		case 0x2: return INSTRUCTION_8xy2;
+		case 0x3: return INSTRUCTION_8xy3;
+		case 0x4: return INSTRUCTION_8xy4;
+		case 0x5: return INSTRUCTION_8xy5;
+		case 0x6: return INSTRUCTION_8xy6;
+		case 0x7: return INSTRUCTION_8xy7;
+		case 0xE: return INSTRUCTION_8xyE;
+		default: return INSTRUCTION_NULL;
+		}
+	case 0x9: return INSTRUCTION_9xy0;
+	case 0xA: return INSTRUCTION_Annn;
+	case 0xB: return INSTRUCTION_Bnnn;
+	case 0xC: return INSTRUCTION_Cxkk;
+	case 0xD: return INSTRUCTION_Dxyn;
+	case 0xE:
+		switch (opcode & 0x000Fu)
+		{
+		case 0x1: return INSTRUCTION_ExA1;
+		case 0xE: return INSTRUCTION_Ex9E;
+		default: return INSTRUCTION_NULL;
+		}
+	default:
+		switch (opcode & 0x00FFu)
+		{
+		case 0x07: return INSTRUCTION_Fx07;
+		case 0x0A: return INSTRUCTION_Fx0A;
+		case 0x15: return INSTRUCTION_Fx15;
+		case 0x18: return INSTRUCTION_Fx18;
+		case 0x1E: return INSTRUCTION_Fx1E;
+		case 0x29: return INSTRUCTION_Fx29;
+		case 0x33: return INSTRUCTION_Fx33;
+		case 0x55: return INSTRUCTION_Fx55;
+		case 0x65: return INSTRUCTION_Fx65;
+		default: return INSTRUCTION_NULL;
+		}
+	}
+}
+
+char const* EngineName(Engine engine)
+{
+	static char const* const names[] = { "interpreter", "cached", "predecoded" };
+	return engine <= ENGINE_PREDECODED ? names[engine] : "?";
+}
+
+char const* InstructionName(Instruction instruction)
+{
+	return instruction < INSTRUCTION_COUNT ? instruction_names[instruction] : "????";
+}
+
+
 //Initializer
 Chip8::Chip8()
 	//: random_num_engine(std::chrono::system_clock::now().time_since_epoch().count()) //Use the sustem clock for the random number engine
@@ -57,12 +183,35 @@ Chip8::Chip8()
 	}
 
 	//An instrucvtion which places a random number to a rtegister
-	//In this case, the system clock can be used to generate the random number
+	//Every machine starts from the same seed, hosts that want different games call Seed
+	Seed(default_random_seed);
+
+	//Thread safe, only the first constructor builds the tables
+	static bool const tables_built = BuildTables();
+	(void)tables_built;
 
-	//Generates random number between 0 and 255 --> stored as random_byte
-	//random_byte = std::uniform_int_distribution<uint8_t>(0, 255U); //Initalize RNG
+	static uint64_t const empty_rom_hash = HashRomMemory(nullptr, 0);
+	memory_hash = HashLowMemory() ^ empty_rom_hash;
+}
+
+Chip8::Chip8Func Chip8::table[0xF + 1];
+Chip8::Chip8Func Chip8::table0[0xF + 1];
+Chip8::Chip8Func Chip8::table8[0xF + 1];
+Chip8::Chip8Func Chip8::tableE[0xF + 1];
+Chip8::Chip8Func Chip8::tableF[0xFF + 1];
 
-	random_byte = (rand() % 0xFF);
+bool Chip8::BuildTables()
+{
+	for (unsigned int pixel = 0; pixel < VIDEO_WIDTH * VIDEO_HEIGHT; ++pixel)
+	{
+		pixel_keys[pixel] = MixKey(pixel_key_base + pixel);
+	}
+
+	//Unknown opcodes do nothing, every entry starts as OP_NULL
+	for (Chip8Func& entry : table0) entry = &Chip8::OP_NULL;
+	for (Chip8Func& entry : table8) entry = &Chip8::OP_NULL;
+	for (Chip8Func& entry : tableE) entry = &Chip8::OP_NULL;
+	for (Chip8Func& entry : tableF) entry = &Chip8::OP_NULL;
 
 	//Decoding an opcode through function pointer arrays instead of a case-switch
 	table[0x0] = &Chip8::Table0;
@@ -107,6 +256,8 @@ Chip8::Chip8()
 	tableF[0x33] = &Chip8::OP_Fx33;
 	tableF[0x55] = &Chip8::OP_Fx55;
 	tableF[0x65] = &Chip8::OP_Fx65;
+
+	return true;
 }
 
 //Get next instruction in the form of an opcode.
@@ -116,15 +267,76 @@ Chip8::Chip8()
 //First digit of opcode is obtained through bitmask, and shifted over so it becomes single digit
 void Chip8::Cycle()
 {
-	// Fetch
-	opcode = (memory[program_counter] << 8u) | memory[program_counter + 1];
+	Step();
+	TickTimers();
+}
+
+void Chip8::Step()
+{
+	NoHooks none;
+	StepHooked(none);
+}
+
+//Memory pages are 64 bytes, one bit each in dirty_pages
+//A clean page still holds the bytes the ROM image was decoded from
+void Chip8::StepCached()
+{
+	program_counter &= memory_mask;
+
+	if (!rom_image || (dirty_pages >> (program_counter >> 6u)) & 1u)
+	{
+		Step();
+		return;
+	}
+
+	opcode = (memory[program_counter] << 8u) | memory[(program_counter + 1) & memory_mask];
+
+	uint8_t instruction = rom_image->decoded[program_counter];
 
-	// Increment the PC before we execute anything
 	program_counter += 2;
 
-	// Decode and Execute
+	((*this).*(instruction_table[instruction]))();
+}
+
+void Chip8::Execute(uint16_t instruction)
+{
+	opcode = instruction;
 	((*this).*(table[(opcode & 0xF000u) >> 12u]))();
+}
 
+void Chip8::StepPredecoded()
+{
+	program_counter &= memory_mask;
+
+	opcode = (memory[program_counter] << 8u) | memory[(program_counter + 1) & memory_mask];
+
+	uint8_t instruction = rom_image->decoded[program_counter];
+
+	program_counter += 2;
+
+	((*this).*(instruction_table[instruction]))();
+}
+
+void Chip8::StepSelected()
+{
+	switch (engine)
+	{
+	case ENGINE_PREDECODED:
+		StepPredecoded();
+		break;
+
+	case ENGINE_CACHED:
+		StepCached();
+		break;
+
+	default:
+		Step();
+		break;
+	}
+}
+
+void Chip8::TickTimers()
+{
 	// Decrement the delay timer if it's been set
 	if (delay_timer > 0)
 	{
@@ -138,6 +350,234 @@ void Chip8::Cycle()
 	}
 }
 
+//Timers count down at 60Hz no matter how many instructions run in a frame
+void Chip8::RunFrame(unsigned int cycles)
+{
+	//One engine for the whole frame, so the loop is a plain call per instruction
+	switch (engine)
+	{
+	case ENGINE_PREDECODED:
+		for (unsigned int i = 0; i < cycles; ++i)
+		{
+			StepPredecoded();
+		}
+		break;
+
+	case ENGINE_CACHED:
+		for (unsigned int i = 0; i < cycles; ++i)
+		{
+			StepCached();
+		}
+		break;
+
+	default:
+		for (unsigned int i = 0; i < cycles; ++i)
+		{
+			Step();
+		}
+		break;
+	}
+
+	TickTimers();
+}
+
+void Chip8::SetKeyWait(KeyWaitFunc func, void* context)
+{
+	key_wait = func;
+	key_wait_context = context;
+}
+
+void Chip8::GetRegisters(Chip8Registers& out) const
+{
+	memcpy(out.registers, registers, sizeof(registers));
+	out.delay_timer = delay_timer;
+	out.sound_timer = sound_timer;
+	out.stack_pointer = stack_pointer;
+	out.index_register = index_register;
+	out.program_counter = program_counter;
+	out.opcode = opcode;
+	memcpy(out.stack, stack, sizeof(stack));
+}
+
+void Chip8::SetRegisters(Chip8Registers const& in)
+{
+	memcpy(registers, in.registers, sizeof(registers));
+	delay_timer = in.delay_timer;
+	sound_timer = in.sound_timer;
+	stack_pointer = in.stack_pointer & stack_mask;
+	index_register = in.index_register;
+	program_counter = in.program_counter;
+	opcode = in.opcode;
+	memcpy(stack, in.stack, sizeof(stack));
+}
+
+void Chip8::DecodeMemory(uint8_t* decoded) const
+{
+	for (unsigned int address = 0; address < MEMORY_SIZE; ++address)
+	{
+		uint16_t word = (memory[address] << 8u) | memory[(address + 1) & memory_mask];
+		decoded[address] = DecodeInstruction(word);
+	}
+}
+
+//The instruction starting one byte before address also contains the written byte, so its page is dirty too
+void Chip8::StoreMemory(uint16_t address, uint8_t value)
+{
+	address &= memory_mask;
+	memory_hash ^= MemoryKey(address, memory[address]) ^ MemoryKey(address, value);
+	memory[address] = value;
+
+	if (heatmap)
+	{
+		++heatmap->writes[address];
+	}
+
+	dirty_pages |= (1ull << (address >> 6u)) | (1ull << (((address - 1) & memory_mask) >> 6u));
+}
+
+uint64_t Chip8::StateHash() const
+{
+	return HashCpu() ^ memory_hash ^ video_hash;
+}
+
+uint64_t Chip8::ComputeStateHash() const
+{
+	return HashCpu() ^ HashMemory() ^ HashVideo();
+}
+
+uint64_t Chip8::HashCpu() const
+{
+	uint8_t state[REGISTER_COUNT + 17 + sizeof(stack)];
+	uint8_t* out = state;
+
+	memcpy(out, registers, REGISTER_COUNT);
+	out += REGISTER_COUNT;
+
+	*out++ = delay_timer;
+	*out++ = sound_timer;
+	*out++ = stack_pointer;
+	memcpy(out, &index_register, 2);
+	memcpy(out + 2, &program_counter, 2);
+	memcpy(out + 4, &opcode, 2);
+	memcpy(out + 6, &random_state, 8);
+	out += 14;
+
+	memcpy(out, stack, sizeof(stack));
+
+	return HashRom(state, sizeof(state));
+}
+
+//Keys of the low pages of a freshly constructed machine (fonts, zeroes), one entry per 64 byte page
+struct LowPageHashes
+{
+	uint64_t pages[ROM_START_ADDRESS >> 6u]{};
+
+	LowPageHashes()
+	{
+		for (unsigned int address = 0; address < ROM_START_ADDRESS; ++address)
+		{
+			bool font = address >= font_start_mem && address < font_start_mem + num_of_fonts;
+			uint8_t value = font ? fonts[address - font_start_mem] : 0;
+			pages[address >> 6u] ^= MemoryKey(address, value);
+		}
+	}
+};
+
+uint64_t Chip8::HashLowMemory() const
+{
+	static const LowPageHashes fresh;
+	uint64_t hash = 0;
+
+	for (unsigned int page = 0; page < (ROM_START_ADDRESS >> 6u); ++page)
+	{
+		if (!((dirty_pages >> page) & 1u))
+		{
+			hash ^= fresh.pages[page];
+			continue;
+		}
+
+		for (unsigned int address = page << 6u; address < (page + 1) << 6u; ++address)
+		{
+			hash ^= MemoryKey(address, memory[address]);
+		}
+	}
+
+	return hash;
+}
+
+uint64_t Chip8::HashRomMemory(uint8_t const* data, size_t size)
+{
+	uint64_t hash = 0;
+
+	for (unsigned int offset = 0; offset < ROM_MAX_SIZE; ++offset)
+	{
+		hash ^= MemoryKey(start_mem + offset, offset < size ? data[offset] : 0);
+	}
+
+	return hash;
+}
+
+uint64_t Chip8::HashMemory() const
+{
+	uint64_t hash = 0;
+
+	for (unsigned int address = 0; address < MEMORY_SIZE; ++address)
+	{
+		hash ^= MemoryKey(address, memory[address]);
+	}
+
+	return hash;
+}
+
+uint64_t Chip8::HashVideo() const
+{
+	uint64_t hash = 0;
+
+	for (unsigned int pixel = 0; pixel < VIDEO_WIDTH * VIDEO_HEIGHT; ++pixel)
+	{
+		if (video[pixel])
+		{
+			hash ^= pixel_keys[pixel];
+		}
+	}
+
+	return hash;
+}
+
+void Chip8::Seed(uint64_t seed)
+{
+	//xorshift must not start from 0
+	random_state = MixKey(seed) | 1u;
+}
+
+uint8_t Chip8::NextRandom()
+{
+	random_state ^= random_state >> 12u;
+	random_state ^= random_state << 25u;
+	random_state ^= random_state >> 27u;
+
+	//The high bits of the xorshift64* output are the best ones
+	return static_cast<uint8_t>((random_state * 0x2545F4914F6CDD1Dull) >> 56u);
+}
+
+//Pixels in video are either all on (0xFFFFFFFF) or off, so 8 pixels fit into a byte
+//Used by anything that stores or compares frames (recorder, observations)
+void Chip8::PackVideo(uint8_t* packed) const
+{
+	for (unsigned int i = 0; i < VIDEO_PACKED_SIZE; ++i)
+	{
+		uint32_t const* pixels = &video[i * 8];
+		uint8_t byte = 0;
+
+		for (unsigned int bit = 0; bit < 8; ++bit)
+		{
+			byte = (byte << 1) | (pixels[bit] ? 1u : 0u);
+		}
+
+		packed[i] = byte;
+	}
+}
+
 //
 void Chip8::Table0()
 {
@@ -170,6 +610,7 @@ void Chip8::OP_NULL()
 void Chip8::OP_00E0()//CLS
 {
 	memset(video, 0, sizeof(video));
+	video_hash = 0;
 }
 
 // 00EE: RET: return from a subroutine --> top of stack has adrerss of one instruction past the one that calls the subroutine
@@ -177,7 +618,7 @@ void Chip8::OP_00E0()//CLS
 void Chip8::OP_00EE() //RET
 {
 	//decrement stack pointer
-	--stack_pointer;
+	stack_pointer = (stack_pointer - 1) & stack_mask;
 	program_counter = stack[stack_pointer];
 }
 
@@ -197,7 +638,7 @@ void Chip8::OP_2nnn() //Call addr
 	uint16_t address = opcode & 0x0FFFu;
 
 	stack[stack_pointer] = program_counter;
-	++stack_pointer;
+	stack_pointer = (stack_pointer + 1) & stack_mask;
 	program_counter = address;
 }
 
@@ -275,6 +716,8 @@ void Chip8::OP_8xy1() // OR Vx,Vy
 {
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 	uint8_t Vy = (opcode & 0x00F0u) >> 4u;
+
+	registers[Vx] |= registers[Vy];
 }
 
 //8xy2: Set Vx = Vx and Vy
@@ -299,6 +742,7 @@ void Chip8::OP_8xy3()
 // Vx and Vy is added together, but if the sum is > 9 bits (255), VF is then set to 1
 //Otherwise it is set to 0. Lowest 8 bits of the sum are kept and stored in Vx
 //ADD with overflow flag
+//The flags of 8xy4 - 8xyE are written after the result, so with x = F the flag is what VF holds
 void Chip8::OP_8xy4()  // ADD Vx,Vy
 {
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
@@ -306,64 +750,46 @@ void Chip8::OP_8xy4()  // ADD Vx,Vy
 
 	uint16_t sum = registers[Vx] + registers[Vy];
 
-	if (sum > 255U)
-	{
-		registers[0xF] = 1;
-	}
-	else
-	{
-		registers[0xF] = 0;
-	}
-
 	registers[Vx] = sum & 0xFFu;
+	registers[0xF] = sum > 255U ? 1 : 0;
 }
 
 //8xy5: Set Vx = Vx - Vy
 // VF = Not borrow
-// Vx > Vy, then VF = 1, else 0. Vy is then subtracted from Vx and stored in Vx
+// Vx >= Vy, then VF = 1, else 0. Vy is then subtracted from Vx and stored in Vx
 void Chip8::OP_8xy5() // SUB Vx, Vy
 {
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 	uint8_t Vy = (opcode & 0x00F0u) >> 4u;
 
-	if (registers[Vx] > registers[Vy])
-	{
-		registers[0xF] = 1;
-	}
-	else
-	{
-		registers[0xF] = 0;
-	}
+	uint8_t notBorrow = registers[Vx] >= registers[Vy] ? 1 : 0;
 
 	registers[Vx] -= registers[Vy];
+	registers[0xF] = notBorrow;
 }
 
 //8xy6: Set Vx = Vx SHR 1 -> if least-sig bit of Vx = 1, then VF = 1, else 0. Then divide Vx by 2
 void Chip8::OP_8xy6() //SHR Vx
 {
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	registers[0xF] = (registers[Vx] & 0x1u);
+	uint8_t lowBit = registers[Vx] & 0x1u;
+
 	registers[Vx] >>= 1;
+	registers[0xF] = lowBit;
 }
 
 //8xy7: Set Vy - Vx, VF = Not Borrow
-// In the case Vy > Vx, then VF = 1, else 0
+// In the case Vy >= Vx, then VF = 1, else 0
 //Then Vx is sibtracted from Vy, results stored in Vx
 void Chip8::OP_8xy7() //SUBN Vx,Vy
 {
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 	uint8_t Vy = (opcode & 0x00F0u) >> 4u;
 
-	if (registers[Vy] > registers[Vx])
-	{
-		registers[0xF] = 1;
-	}
-	else
-	{
-		registers[0xF] = 0;
-	}
+	uint8_t notBorrow = registers[Vy] >= registers[Vx] ? 1 : 0;
 
 	registers[Vx] = registers[Vy] - registers[Vx];
+	registers[0xF] = notBorrow;
 }
 
 //8xyE: If most significant but of Vx = 1, then VF = 1, else 0
@@ -374,9 +800,10 @@ void Chip8::OP_8xyE()
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 
 	// Save MSB in VF
-	registers[0xF] = (registers[Vx] & 0x80u) >> 7u;
+	uint8_t highBit = (registers[Vx] & 0x80u) >> 7u;
 
 	registers[Vx] <<= 1;
+	registers[0xF] = highBit;
 }
 
 //9xy0 : Skip the next instruction if Vx != Vy
@@ -415,7 +842,7 @@ void Chip8::OP_Cxkk() //RND Vx, byte
 	uint8_t byte = opcode & 0x00FFu;
 
 
-	registers[Vx] = random_byte & byte;
+	registers[Vx] = NextRandom() & byte;
 }
 
 
@@ -436,14 +863,30 @@ void Chip8::OP_Dxyn()
 
 	registers[0xF] = 0;
 
+	//Keys of every toggled pixel
+	uint64_t toggled = 0;
+
 	for (unsigned int row = 0; row < height; ++row)
 	{
-		uint8_t spriteByte = memory[index_register + row];
+		//Sprites are clipped at the bottom and right edges of the screen
+		if (yPos + row >= VIDEO_HEIGHT)
+		{
+			break;
+		}
 
-		for (unsigned int col = 0; col < 8; ++col)
+		uint16_t spriteAddress = (index_register + row) & memory_mask;
+		uint8_t spriteByte = memory[spriteAddress];
+
+		if (heatmap)
+		{
+			++heatmap->reads[spriteAddress];
+		}
+
+		for (unsigned int col = 0; col < 8 && xPos + col < VIDEO_WIDTH; ++col)
 		{
 			uint8_t spritePixel = spriteByte & (0x80u >> col);
-			uint32_t* screenPixel = &video[(yPos + row) * VIDEO_WIDTH + (xPos + col)];
+			unsigned int pixel = (yPos + row) * VIDEO_WIDTH + (xPos + col);
+			uint32_t* screenPixel = &video[pixel];
 
 			// Sprite pixel is on
 			if (spritePixel)
@@ -456,9 +899,12 @@ void Chip8::OP_Dxyn()
 
 				// Effectively XOR with the sprite pixel
 				*screenPixel ^= 0xFFFFFFFF;
+				toggled ^= pixel_keys[pixel];
 			}
 		}
 	}
+
+	video_hash ^= toggled;
 }
 
 //Ex9E: Skips the next instruction if key with the value of Vx is pressed
@@ -468,9 +914,9 @@ void Chip8::OP_Ex9E() //SKP Vx
 {
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 
-	uint8_t key = registers[Vx];
+	uint8_t key = registers[Vx] & 0xFu;
 
-	if (keypad[key])
+	if ((keypad >> key) & 1u)
 	{
 		program_counter += 2;
 	}
@@ -482,9 +928,9 @@ void Chip8::OP_ExA1() //SKNP Vx
 {
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 
-	uint8_t key = registers[Vx];
+	uint8_t key = registers[Vx] & 0xFu;
 
-	if (!keypad[key])
+	if (!((keypad >> key) & 1u))
 	{
 		program_counter += 2;
 	}
@@ -498,82 +944,38 @@ void Chip8::OP_Fx07() //LD Vx, DT
 	registers[Vx] = delay_timer;
 }
 
+//Find first set bit of a non zero key mask
+static uint8_t LowestKey(uint16_t keys)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanForward(&index, keys);
+	return static_cast<uint8_t>(index);
+#else
+	return static_cast<uint8_t>(__builtin_ctz(keys));
+#endif
+}
+
 //Fx0A: Wait for key press, and store the value of the key press into Vx
-//decrement the program counter by 2 whenever a keypad value is not detected
+//The lowest key that is down wins. With a key wait function the emulation blocks until a key goes down,
+//otherwise the program counter is decremented by 2 so the instruction runs again
 
 void Chip8::OP_Fx0A() //LD Vx, K
 {
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 
-
-	if (keypad[0])
-	{
-		registers[Vx] = 0;
-	}
-	else if (keypad[1])
-	{
-		registers[Vx] = 1;
-	}
-	else if (keypad[2])
-	{
-		registers[Vx] = 2;
-	}
-	else if (keypad[3])
-	{
-		registers[Vx] = 3;
-	}
-	else if (keypad[4])
-	{
-		registers[Vx] = 4;
-	}
-	else if (keypad[5])
+	if (keypad == 0 && key_wait)
 	{
-		registers[Vx] = 5;
+		keypad = key_wait(key_wait_context);
 	}
-	else if (keypad[6])
-	{
-		registers[Vx] = 6;
-	}
-	else if (keypad[7])
-	{
-		registers[Vx] = 7;
-	}
-	else if (keypad[8])
-	{
-		registers[Vx] = 8;
-	}
-	else if (keypad[9])
-	{
-		registers[Vx] = 9;
-	}
-	else if (keypad[10])
-	{
-		registers[Vx] = 10;
-	}
-	else if (keypad[11])
-	{
-		registers[Vx] = 11;
-	}
-	else if (keypad[12])
-	{
-		registers[Vx] = 12;
-	}
-	else if (keypad[13])
-	{
-		registers[Vx] = 13;
-	}
-	else if (keypad[14])
-	{
-		registers[Vx] = 14;
-	}
-	else if (keypad[15])
-	{
-		registers[Vx] = 15;
-	}
-	else
+
+	if (keypad == 0)
 	{
 		program_counter -= 2;
+		return;
 	}
+
+	registers[Vx] = LowestKey(keypad);
 }
 
 //Fx15: Set the delay timer to be equal to Vx
@@ -603,10 +1005,11 @@ void Chip8::OP_Fx1E() //ADD I, Vx
 //Fx29: Set I to the location of sprite for Vx
 //FOnt characters are located at 0x50 that are 5 bytes each
 //the address of the first byte of any character can be obtained by taking the offset from the start address
+//Only the low nibble of Vx is the digit
 void Chip8::OP_Fx29() //LD F, Vx
 {
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
-	uint8_t digit = registers[Vx];
+	uint8_t digit = registers[Vx] & 0xFu;
 
 	index_register = font_start_mem + (5 * digit);
 }
@@ -621,13 +1024,13 @@ void Chip8::OP_Fx33() //LD B, Vx
 	uint8_t Vx = (opcode & 0x0F00u) >> 8u;
 	uint8_t value = registers[Vx];
 
-	memory[index_register + 2] = value % 10;
+	StoreMemory(index_register + 2, value % 10);
 	value /= 10;
 
-	memory[index_register + 1] = value % 10;
+	StoreMemory(index_register + 1, value % 10);
 	value /= 10;
 
-	memory[index_register] = value % 10;
+	StoreMemory(index_register, value % 10);
 }
 
 //Fx55: Stores registers V0 through Vx in memory starting at location I
@@ -637,7 +1040,7 @@ void Chip8::OP_Fx55() //LD[i], Vx
 
 	for (uint8_t i = 0; i <= Vx; ++i)
 	{
-		memory[index_register + i] = registers[i];
+		StoreMemory(index_register + i, registers[i]);
 	}
 }
 
@@ -648,37 +1051,126 @@ void Chip8::OP_Fx65() //LD VX, [I]
 
 	for (uint8_t i = 0; i <= Vx; ++i)
 	{
-		registers[i] = memory[index_register + i];
+		uint16_t address = (index_register + i) & memory_mask;
+		registers[i] = memory[address];
+
+		if (heatmap)
+		{
+			++heatmap->reads[address];
+		}
 	}
 }
 
 
-void Chip8::open_ROM(char const* file_name)
+//The ROM cache maps the file, checks that it fits and keeps one copy per distinct ROM
+//Loading the same ROM again is a hash of the file and a single copy into memory
+bool Chip8::open_ROM(char const* file_name)
 {
-	//Need to open the file as binary
-	//Move file pointer to the end
-	std::ifstream file(file_name, std::ios::binary | std::ios::ate);
+	RomImage const* image = LoadRomImage(file_name);
 
+	if (!image)
+	{
+		return false;
+	}
+
+	load_ROM(*image);
 
-	FILE * po_File = fopen(file_name, "rb");
-	//Standard read file
-	if (file.is_open()) 
+	return true;
+}
+
+void Chip8::load_ROM(RomImage const& image)
+{
+	LoadRomBytes(image.bytes.data(), image.bytes.size(), image.memory_hash);
+
+	rom_image = &image;
+	engine = image.analysis.engine;
+}
+
+unsigned int Chip8::reload_ROM(RomImage const& image, bool keep_state)
+{
+	if (!keep_state)
 	{
-		//Check file size, and buffer to hold contents:
-		std::streampos size = file.tellg();
-		char* buffer = new char[size];
+		//Host settings and the random generator carry over to the restarted machine
+		Chip8 fresh;
+		fresh.keypad = keypad;
+		fresh.key_wait = key_wait;
+		fresh.key_wait_context = key_wait_context;
+		fresh.random_state = random_state;
+		fresh.heatmap = heatmap;
+		fresh.load_ROM(image);
+
+		unsigned int changed = 0;
+
+		for (unsigned int address = 0; address < MEMORY_SIZE; ++address)
+		{
+			changed += memory[address] != fresh.memory[address];
+		}
+
+		*this = fresh;
+		return changed;
+	}
 
-		//Back to beginning to fill buffer
-		file.seekg(0, std::ios::beg);
-		file.read(buffer, size);
-		file.close();
+	//Bytes of the version loaded now, memory itself for ROMs that were not loaded through the cache
+	uint8_t const* previous = rom_image ? rom_image->bytes.data() : &memory[start_mem];
+	size_t previousSize = rom_image ? rom_image->bytes.size() : ROM_MAX_SIZE;
+	unsigned int changed = 0;
 
-		//Load ROM into chip8 memory starting at 0x200
-		for (long i = 0; i < size; ++i)
+	for (unsigned int offset = 0; offset < ROM_MAX_SIZE; ++offset)
+	{
+		uint8_t before = offset < previousSize ? previous[offset] : 0;
+		uint8_t after = offset < image.bytes.size() ? image.bytes[offset] : 0;
+
+		unsigned int address = start_mem + offset;
+
+		//A byte that no longer holds the old version was written by the program, which owns it now
+		if (before != after && memory[address] == before)
 		{
-			memory[start_mem + i] = buffer[i];
+			//Not StoreMemory: the byte now matches the new image, so its page keeps its dirty state
+			memory_hash ^= MemoryKey(address, memory[address]) ^ MemoryKey(address, after);
+			memory[address] = after;
+			++changed;
 		}
+	}
 
-		delete[] buffer;
+	rom_image = &image;
+	engine = image.analysis.engine;
+
+	//The analysis proved its writes miss the code for a fresh machine (PC 0x200, I set by Annn, empty stack),
+	//the I, PC and stack kept from the old version prove nothing, so code writes must still be caught
+	if (engine == ENGINE_PREDECODED)
+	{
+		engine = ENGINE_CACHED;
 	}
-}
\ No newline at end of file
+
+	return changed;
+}
+
+bool Chip8::load_ROM(uint8_t const* data, size_t size)
+{
+	if (size > ROM_MAX_SIZE)
+	{
+		return false;
+	}
+
+	LoadRomBytes(data, size, HashRomMemory(data, size));
+
+	return true;
+}
+
+//Only the ROM pages are replaced, writes below 0x200 still differ from a fresh machine and only their pages are hashed
+//The program starts over as on a fresh machine (PC 0x200, I 0, empty stack), what the ROM analysis assumes when it
+//allows the pre-decoded engine; registers, timers and display are left as they were
+void Chip8::LoadRomBytes(uint8_t const* data, size_t size, uint64_t rom_hash)
+{
+	memcpy(&memory[start_mem], data, size);
+	memset(&memory[start_mem + size], 0, ROM_MAX_SIZE - size);
+
+	program_counter = start_mem;
+	index_register = 0;
+	stack_pointer = 0;
+
+	rom_image = nullptr;
+	engine = ENGINE_INTERPRETER;
+	dirty_pages &= (1ull << (start_mem >> 6u)) - 1;
+	memory_hash = HashLowMemory() ^ rom_hash;
+}
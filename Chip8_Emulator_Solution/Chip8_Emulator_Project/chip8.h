@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <random>
 
@@ -9,15 +10,197 @@ const unsigned int KEY_COUNT = 16;
 const unsigned int MEMORY_SIZE = 4096;
 const unsigned int REGISTER_COUNT = 16;
 const unsigned int STACK_LEVELS = 16;
+//ROMs are loaded at 0x200 and may fill memory up to 0xFFF
+const unsigned int ROM_START_ADDRESS = 0x200;
+const unsigned int ROM_MAX_SIZE = MEMORY_SIZE - ROM_START_ADDRESS;
+//Display packed at 1 bit per pixel (most significant bit is the leftmost pixel)
+const unsigned int VIDEO_ROW_BYTES = VIDEO_WIDTH / 8;
+const unsigned int VIDEO_PACKED_SIZE = VIDEO_ROW_BYTES * VIDEO_HEIGHT;
+
+//Every instruction the dispatch tables can reach, named after their handlers
+//Used for pre-decoded code and anything that reports per instruction
+enum Instruction : uint8_t
+{
+	INSTRUCTION_NULL,
+	INSTRUCTION_00E0,
+	INSTRUCTION_00EE,
+	INSTRUCTION_1nnn,
+	INSTRUCTION_2nnn,
+	INSTRUCTION_3xkk,
+	INSTRUCTION_4xkk,
+	INSTRUCTION_5xy0,
+	INSTRUCTION_6xkk,
+	INSTRUCTION_7xkk,
+	INSTRUCTION_8xy0,
+	INSTRUCTION_8xy1,
+	INSTRUCTION_8xy2,
+	INSTRUCTION_8xy3,
+	INSTRUCTION_8xy4,
+	INSTRUCTION_8xy5,
+	INSTRUCTION_8xy6,
+	INSTRUCTION_8xy7,
+	INSTRUCTION_8xyE,
+	INSTRUCTION_9xy0,
+	INSTRUCTION_Annn,
+	INSTRUCTION_Bnnn,
+	INSTRUCTION_Cxkk,
+	INSTRUCTION_Dxyn,
+	INSTRUCTION_Ex9E,
+	INSTRUCTION_ExA1,
+	INSTRUCTION_Fx07,
+	INSTRUCTION_Fx0A,
+	INSTRUCTION_Fx15,
+	INSTRUCTION_Fx18,
+	INSTRUCTION_Fx1E,
+	INSTRUCTION_Fx29,
+	INSTRUCTION_Fx33,
+	INSTRUCTION_Fx55,
+	INSTRUCTION_Fx65,
+	INSTRUCTION_COUNT
+};
+
+//Same decoding as the function pointer tables in Chip8
+Instruction DecodeInstruction(uint16_t opcode);
+//Opcode pattern of the instruction, e.g. "Dxyn"
+char const* InstructionName(Instruction instruction);
+
+//Ways to run instructions, open_ROM picks the fastest one the ROM analysis allows (see rom_analysis.h)
+enum Engine : uint8_t
+{
+	//Step: fetch and decode from memory
+	ENGINE_INTERPRETER,
+	//StepCached: pre-decoded instructions, pages written since the load are decoded from memory
+	ENGINE_CACHED,
+	//StepPredecoded: pre-decoded instructions only, for ROMs that never write code they run
+	ENGINE_PREDECODED
+};
+
+char const* EngineName(Engine engine);
+
+struct RomImage;
+struct MemoryHeatmap;
+
+//Copy of the CPU state for hosts that inspect a machine (server, debugger, tools)
+struct Chip8Registers
+{
+	uint8_t registers[REGISTER_COUNT];
+	uint8_t delay_timer;
+	uint8_t sound_timer;
+	uint8_t stack_pointer;
+	uint16_t index_register;
+	uint16_t program_counter;
+	uint16_t opcode;
+	uint16_t stack[STACK_LEVELS];
+};
+
+//Hooks for the release core: always executes and compiles away
+struct NoHooks
+{
+	bool BeforeExecute(class Chip8 const&, uint16_t, uint16_t) { return true; }
+};
+
+//Timing policy of RunFrameTimed that counts instructions like RunFrame, so the timed loop compiles to the plain one
+//A policy gets BeginFrame(cycles) at the start of a frame and Admit(chip8, opcode) before every instruction,
+//which returns false to end the frame before the instruction runs, and Charge() once the admitted instruction
+//ran, so an instruction a debugger stops before is not paid for (see vip_timing.h)
+struct NoTiming
+{
+	unsigned int remaining{};
+
+	void BeginFrame(unsigned int cycles) { remaining = cycles; }
+	bool Admit(class Chip8 const&, uint16_t) { return remaining != 0; }
+	void Charge() { --remaining; }
+};
 
 class Chip8 
 {
 public:
 	Chip8();
-	void open_ROM(char const* file_name);
+	//Load a ROM file through the ROM cache, false if it cannot be read or does not fit in 0x200 - 0xFFF
+	bool open_ROM(char const* file_name);
+	//Load a cached ROM, enables the pre-decoded instructions of the image
+	//Loading restarts the program (PC 0x200, I 0, empty stack), also on a machine that has already run
+	void load_ROM(RomImage const& image);
+	//Load a ROM image already in memory, false if it does not fit in 0x200 - 0xFFF
+	bool load_ROM(uint8_t const* data, size_t size);
+	//Switch to a new version of the loaded ROM. keep_state: only bytes that differ between the two versions are
+	//written, and only where memory still holds the old version's byte; everything else (registers, timers,
+	//display, memory the program wrote) stays. A ROM loaded from bytes has no old version to compare with, so
+	//every byte that differs is written. Otherwise the machine restarts on the new version.
+	//Returns the number of bytes of memory that changed
+	unsigned int reload_ROM(RomImage const& image, bool keep_state);
+	//Memory hash keys of 0x200 - 0xFFF after loading data, the part of the memory hash a ROM image precomputes
+	static uint64_t HashRomMemory(uint8_t const* data, size_t size);
+	//Fetch, decode and execute one instruction, then decrement the timers
 	void Cycle();
-	uint8_t keypad[KEY_COUNT]{};
+	//Fetch, decode and execute one instruction without touching the timers
+	void Step();
+	//Same as Step, but dispatches through the pre-decoded instructions of the loaded ROM image
+	//Addresses written since the load (self-modifying code) are decoded from memory instead
+	void StepCached();
+	//StepCached without the check for written pages, only correct when the loaded ROM never writes code it runs
+	void StepPredecoded();
+	//Step with the engine picked for the loaded ROM (the interpreter for ROMs not loaded through the cache)
+	void StepSelected();
+	Engine SelectedEngine() const { return engine; }
+	//All of memory, for tools that scan it (RAM search)
+	uint8_t const* Memory() const { return memory; }
+	//Count the memory reads of Fx65/Dxyn and the writes of Fx33/Fx55 per address, nullptr turns counting off
+	//Copies of the machine count into the same heatmap
+	void SetHeatmap(MemoryHeatmap* map) { heatmap = map; }
+	//Cache image of the loaded ROM (with its analysis), nullptr for ROMs loaded from bytes
+	RomImage const* Image() const { return rom_image; }
+	//Step with a hooks object asked before every instruction: hooks.BeforeExecute(chip8, address, opcode)
+	//returns false to stop before the instruction runs. Plain Step/Cycle/RunFrame have no hooks at all.
+	template <typename Hooks>
+	bool StepHooked(Hooks& hooks);
+	template <typename Hooks>
+	bool CycleHooked(Hooks& hooks);
+	//Decode and execute an opcode that did not come from memory, the program counter is not advanced first
+	//For benchmarks and tools that drive single handlers
+	void Execute(uint16_t instruction);
+	//One 60Hz frame paced by a timing policy instead of an instruction count, then one timer tick
+	//Returns the number of instructions run
+	template <typename Timing>
+	unsigned int RunFrameTimed(Timing& timing, unsigned int cycles);
+	//Opcode at the program counter, the instruction the next Step runs
+	uint16_t NextOpcode() const
+	{
+		uint16_t address = program_counter & (MEMORY_SIZE - 1);
+		return (memory[address] << 8u) | memory[(address + 1) & (MEMORY_SIZE - 1)];
+	}
+	//Decrement the delay and sound timers (60Hz)
+	void TickTimers();
+	//One 60Hz frame: <cycles> instructions (with the selected engine) followed by one timer tick
+	void RunFrame(unsigned int cycles);
+	void GetRegisters(Chip8Registers& out) const;
+	//Replace the CPU state, memory and display are left alone (for tools that set up a machine, e.g. conformance)
+	void SetRegisters(Chip8Registers const& in);
+	uint16_t ProgramCounter() const { return program_counter; }
+	uint16_t Opcode() const { return opcode; }
+	uint16_t IndexRegister() const { return index_register; }
+	uint8_t Register(unsigned int index) const { return registers[index & 0xFu]; }
+	uint8_t ReadMemory(uint16_t address) const { return memory[address & (MEMORY_SIZE - 1)]; }
+	//Decode the instruction at every address of memory into decoded (MEMORY_SIZE entries)
+	void DecodeMemory(uint8_t* decoded) const;
+	//Pack the display into VIDEO_PACKED_SIZE bytes (1 bit per pixel, row by row)
+	void PackVideo(uint8_t* packed) const;
+	//Hash of everything that decides what the machine does next (CPU state, memory, display, random generator)
+	//Keys and caches derived from the ROM are not part of it, machines in the same state hash equal
+	//Memory and display are hashed as they change, so this only hashes the CPU state (about 60 bytes)
+	uint64_t StateHash() const;
+	//Same value computed from scratch over all 12KB, for checking the incremental hash
+	uint64_t ComputeStateHash() const;
+	//Restart the random generator behind Cxkk, machines with the same ROM, seed and keys run identically
+	void Seed(uint64_t seed);
+	//Keys that are down, bit n = key n
+	uint16_t keypad{};
+	//Called by Fx0A when no key is down, blocks until keys are down and returns them (0 = gave up)
+	//Without one, Fx0A re-executes until keypad changes
+	typedef uint16_t (*KeyWaitFunc)(void* context);
+	void SetKeyWait(KeyWaitFunc func, void* context);
 	//Monochrome Display Memory (64 pixels width, 32 pixels length) - Only 2 colors repersented
+	//Only the instructions write it, changing it from outside is not seen by StateHash
 	uint32_t video[VIDEO_WIDTH * VIDEO_HEIGHT]{};
 private:
 	/* 
@@ -55,9 +238,33 @@ private:
 
 	
 	//Instruction for random number
-	//Random number engine class which generates pseudo-random numbers
-	//std::default_random_engine random_num_engine;
-	uint8_t random_byte; //Produces random integer values uniformlly distributed on a closed interval [a,b]
+	//xorshift64* generator advanced by every Cxkk, each instance has its own so no state is shared between threads
+	uint64_t random_state{};
+	uint8_t NextRandom();
+
+	//XOR of a key per (address, value) over all of memory, and of a key per lit pixel
+	//Kept up to date by StoreMemory, 00E0, Dxyn and the ROM loads
+	uint64_t memory_hash{};
+	uint64_t video_hash{};
+	uint64_t HashMemory() const;
+	//Memory hash keys of 0x000 - 0x1FF: precomputed for pages still as the constructor left them
+	uint64_t HashLowMemory() const;
+	void LoadRomBytes(uint8_t const* data, size_t size, uint64_t rom_hash);
+	uint64_t HashVideo() const;
+	uint64_t HashCpu() const;
+
+	KeyWaitFunc key_wait{};
+	void* key_wait_context{};
+
+	//ROM image in the ROM cache (kept while a reference is held, see rom_cache.h), its decoded instructions are valid for clean pages
+	RomImage const* rom_image{};
+	//Bit n set -> memory page n (64 bytes) was written since the ROM was loaded
+	uint64_t dirty_pages{};
+	Engine engine{ ENGINE_INTERPRETER };
+	MemoryHeatmap* heatmap{};
+
+	//Every write to memory made by an instruction goes through here
+	void StoreMemory(uint16_t address, uint8_t value);
 
 
 	//Instruction Functions -- > in chip8.cpp
@@ -177,10 +384,73 @@ private:
 	//Ox65 --> 101
 	//Function pointer arrays
 	typedef void (Chip8::*Chip8Func)();
-	Chip8Func table[0xF + 1]{ &Chip8::OP_NULL };
-	Chip8Func table0[0xE + 1]{ &Chip8::OP_NULL };
-	Chip8Func table8[0xE + 1]{ &Chip8::OP_NULL };
-	Chip8Func tableE[0xE + 1]{ &Chip8::OP_NULL };
-	Chip8Func tableF[0x65 + 1]{ &Chip8::OP_NULL };
+	//The tables are the same for every instance, so they are static and copying a Chip8 only copies machine state:
+	//a copy (constructor or assignment) is a complete snapshot of the machine, about 12KB
+	static Chip8Func table[0xF + 1];
+	//Sub-tables cover every value of the nibble/byte they are indexed with, unused entries are OP_NULL
+	static Chip8Func table0[0xF + 1];
+	static Chip8Func table8[0xF + 1];
+	static Chip8Func tableE[0xF + 1];
+	static Chip8Func tableF[0xFF + 1];
+	//Fills the tables, runs once before the first instance is constructed
+	static bool BuildTables();
+	//Handler of each Instruction, shared by every instance
+	static Chip8Func const instruction_table[INSTRUCTION_COUNT];
+
+};
+
+
+//Step() is this with NoHooks, so the release instantiation has no hook code left in it
+template <typename Hooks>
+bool Chip8::StepHooked(Hooks& hooks)
+{
+	// Fetch
+	program_counter &= (MEMORY_SIZE - 1);
+	uint16_t next = (memory[program_counter] << 8u) | memory[(program_counter + 1) & (MEMORY_SIZE - 1)];
+
+	if (!hooks.BeforeExecute(*this, program_counter, next))
+	{
+		return false;
+	}
+
+	opcode = next;
+
+	// Increment the PC before we execute anything
+	program_counter += 2;
+
+	// Decode and Execute
+	((*this).*(table[(opcode & 0xF000u) >> 12u]))();
+
+	return true;
+}
+
+template <typename Hooks>
+bool Chip8::CycleHooked(Hooks& hooks)
+{
+	if (!StepHooked(hooks))
+	{
+		return false;
+	}
+
+	TickTimers();
+
+	return true;
+}
+
+template <typename Timing>
+unsigned int Chip8::RunFrameTimed(Timing& timing, unsigned int cycles)
+{
+	unsigned int executed = 0;
+	timing.BeginFrame(cycles);
+
+	while (timing.Admit(*this, NextOpcode()))
+	{
+		StepSelected();
+		timing.Charge();
+		++executed;
+	}
+
+	TickTimers();
 
-};
\ No newline at end of file
+	return executed;
+}
@@ -0,0 +1,359 @@
+#include "debugger.h"
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+
+void Debugger::AddBreakpoint(uint16_t address)
+{
+	breakpoints.set(address & (MEMORY_SIZE - 1));
+	RebuildStops();
+}
+
+void Debugger::RemoveBreakpoint(uint16_t address)
+{
+	breakpoints.reset(address & (MEMORY_SIZE - 1));
+	RebuildStops();
+}
+
+void Debugger::AddCondition(DebugCondition const& condition)
+{
+	conditions.push_back(condition);
+	conditions.back().address &= (MEMORY_SIZE - 1);
+	conditions_held.push_back(false);
+	RebuildStops();
+}
+
+void Debugger::AddWatchpoint(uint16_t first, uint16_t last)
+{
+	for (unsigned int address = first; address <= last && address < MEMORY_SIZE; ++address)
+	{
+		watched.set(address);
+	}
+
+	has_watchpoints = watched.any();
+}
+
+void Debugger::ClearWatchpoints()
+{
+	watched.reset();
+	has_watchpoints = false;
+}
+
+void Debugger::SingleStep()
+{
+	stepping = true;
+	resuming = true;
+}
+
+void Debugger::Continue()
+{
+	stepping = false;
+	resuming = true;
+}
+
+void Debugger::RebuildStops()
+{
+	stops = breakpoints;
+	has_global_conditions = false;
+
+	for (DebugCondition const& condition : conditions)
+	{
+		if (condition.any_address)
+		{
+			has_global_conditions = true;
+		}
+		else
+		{
+			stops.set(condition.address);
+		}
+	}
+}
+
+//Every any_address condition is evaluated (not just up to the first hit), so each one knows whether it held before
+bool Debugger::CheckConditions(Chip8 const& chip8, uint16_t address)
+{
+	bool broken = false;
+
+	for (size_t i = 0; i < conditions.size(); ++i)
+	{
+		DebugCondition const& condition = conditions[i];
+
+		if (!condition.any_address && condition.address != address)
+		{
+			continue;
+		}
+
+		uint8_t value = chip8.Register(condition.reg);
+		bool hit = false;
+
+		switch (condition.compare)
+		{
+		case COMPARE_EQUAL: hit = value == condition.value; break;
+		case COMPARE_NOT_EQUAL: hit = value != condition.value; break;
+		case COMPARE_LESS: hit = value < condition.value; break;
+		case COMPARE_GREATER: hit = value > condition.value; break;
+		}
+
+		if (condition.any_address)
+		{
+			bool held = conditions_held[i];
+			conditions_held[i] = hit;
+			hit = hit && !held;
+		}
+
+		if (hit && !broken)
+		{
+			std::ostringstream text;
+			text << "condition V" << std::hex << std::uppercase << int(condition.reg)
+				<< " = " << int(value) << " at " << address;
+			reason = text.str();
+			broken = true;
+		}
+	}
+
+	return broken;
+}
+
+bool Debugger::BeforeExecute(Chip8 const& chip8, uint16_t address, uint16_t opcode)
+{
+	if (resuming)
+	{
+		resuming = false;
+		return true;
+	}
+
+	if (stepping)
+	{
+		reason = "step";
+		return false;
+	}
+
+	//Fast path: nothing set for this address. Conditions are checked even at a breakpoint, so the any_address
+	//ones keep track of whether they held
+	if (stops.test(address) || has_global_conditions)
+	{
+		bool conditionHit = CheckConditions(chip8, address);
+
+		if (breakpoints.test(address))
+		{
+			std::ostringstream text;
+			text << "breakpoint at " << std::hex << std::uppercase << address;
+			reason = text.str();
+			return false;
+		}
+
+		if (conditionHit)
+		{
+			return false;
+		}
+	}
+
+	//Fx33 writes I..I+2, Fx55 writes I..I+x
+	if (has_watchpoints && (opcode & 0xF000u) == 0xF000u)
+	{
+		unsigned int count = 0;
+
+		if ((opcode & 0x00FFu) == 0x33u)
+		{
+			count = 3;
+		}
+		else if ((opcode & 0x00FFu) == 0x55u)
+		{
+			count = ((opcode & 0x0F00u) >> 8u) + 1;
+		}
+
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			uint16_t target = (chip8.IndexRegister() + i) & (MEMORY_SIZE - 1);
+
+			if (watched.test(target))
+			{
+				std::ostringstream text;
+				text << "watchpoint " << std::hex << std::uppercase << target << " written at " << address;
+				reason = text.str();
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+void Debugger::PrintInstruction(Chip8 const& chip8, uint16_t address, std::ostream& out) const
+{
+	uint16_t opcode = (chip8.ReadMemory(address) << 8u) | chip8.ReadMemory(address + 1);
+
+	out << std::hex << std::uppercase << std::setfill('0')
+		<< std::setw(3) << address << ": " << std::setw(4) << opcode
+		<< "  " << InstructionName(DecodeInstruction(opcode)) << std::dec << "\n";
+}
+
+void Debugger::PrintRegisters(Chip8 const& chip8, std::ostream& out) const
+{
+	Chip8Registers state;
+	chip8.GetRegisters(state);
+
+	out << std::hex << std::uppercase << std::setfill('0');
+
+	for (unsigned int i = 0; i < REGISTER_COUNT; ++i)
+	{
+		out << "V" << i << "=" << std::setw(2) << int(state.registers[i]) << (i % 8 == 7 ? "\n" : " ");
+	}
+
+	out << "PC=" << std::setw(3) << state.program_counter
+		<< " I=" << std::setw(3) << state.index_register
+		<< " SP=" << int(state.stack_pointer)
+		<< " DT=" << std::setw(2) << int(state.delay_timer)
+		<< " ST=" << std::setw(2) << int(state.sound_timer) << std::dec << "\n";
+}
+
+void Debugger::PrintStack(Chip8 const& chip8, std::ostream& out) const
+{
+	Chip8Registers state;
+	chip8.GetRegisters(state);
+
+	out << std::hex << std::uppercase << std::setfill('0');
+
+	//Most recent call first
+	for (unsigned int depth = 0; depth < state.stack_pointer && depth < STACK_LEVELS; ++depth)
+	{
+		unsigned int level = state.stack_pointer - 1 - depth;
+		out << "#" << std::dec << depth << std::hex << " [" << level << "] return to " << std::setw(3) << state.stack[level] << "\n";
+	}
+
+	if (state.stack_pointer == 0)
+	{
+		out << "(empty)\n";
+	}
+
+	out << std::dec;
+}
+
+void Debugger::PrintMemory(Chip8 const& chip8, uint16_t first, uint16_t count, std::ostream& out) const
+{
+	out << std::hex << std::uppercase << std::setfill('0');
+
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		if (i % 16 == 0)
+		{
+			out << std::setw(3) << ((first + i) & (MEMORY_SIZE - 1)) << ":";
+		}
+
+		out << " " << std::setw(2) << int(chip8.ReadMemory(first + i));
+
+		if (i % 16 == 15 || i + 1 == count)
+		{
+			out << "\n";
+		}
+	}
+
+	out << std::dec;
+}
+
+//Commands:
+//	s                     single step
+//	c                     continue
+//	b <addr>              breakpoint, d <addr> removes it
+//	w <first> [last]      watch memory writes (by Fx33/Fx55, the only instructions that write), wc clears them
+//	if <Vx> <op> <value> [addr]   conditional break (op: == != < >), without addr when it becomes true
+//	r / st / m <addr> [n] registers, stack, memory dump
+//	q                     quit
+bool Debugger::Prompt(Chip8 const& chip8)
+{
+	std::cout << "break: " << reason << "\n";
+	PrintInstruction(chip8, chip8.ProgramCounter(), std::cout);
+
+	std::string line;
+
+	while (std::cout << "(chip8) " << std::flush, std::getline(std::cin, line))
+	{
+		std::istringstream in(line);
+		std::string command;
+		in >> command;
+
+		if (command == "s" || command.empty())
+		{
+			SingleStep();
+			return true;
+		}
+		else if (command == "c")
+		{
+			Continue();
+			return true;
+		}
+		else if (command == "q")
+		{
+			return false;
+		}
+		else if (command == "b" || command == "d")
+		{
+			unsigned int address;
+
+			if (in >> std::hex >> address)
+			{
+				command == "b" ? AddBreakpoint(address) : RemoveBreakpoint(address);
+			}
+		}
+		else if (command == "w")
+		{
+			unsigned int first, last;
+
+			if (in >> std::hex >> first)
+			{
+				AddWatchpoint(first, (in >> std::hex >> last) ? last : first);
+			}
+		}
+		else if (command == "wc")
+		{
+			ClearWatchpoints();
+		}
+		else if (command == "if")
+		{
+			std::string reg, op;
+			unsigned int value, address;
+
+			if (in >> reg >> op >> std::hex >> value && reg.size() == 2 && (reg[0] == 'V' || reg[0] == 'v'))
+			{
+				DebugCondition condition{};
+				condition.reg = std::strtoul(reg.c_str() + 1, nullptr, 16) & 0xFu;
+				condition.value = value & 0xFFu;
+				condition.compare = op == "!=" ? COMPARE_NOT_EQUAL : op == "<" ? COMPARE_LESS : op == ">" ? COMPARE_GREATER : COMPARE_EQUAL;
+				condition.any_address = !(in >> std::hex >> address);
+				condition.address = condition.any_address ? 0 : address;
+				AddCondition(condition);
+			}
+		}
+		else if (command == "r")
+		{
+			PrintRegisters(chip8, std::cout);
+		}
+		else if (command == "st")
+		{
+			PrintStack(chip8, std::cout);
+		}
+		else if (command == "m")
+		{
+			unsigned int first, count;
+
+			if (in >> std::hex >> first)
+			{
+				PrintMemory(chip8, first, (in >> std::hex >> count) ? count : 64, std::cout);
+			}
+		}
+		else
+		{
+			std::cout << "s                             single step\n"
+				<< "c                             continue\n"
+				<< "b <addr>, d <addr>            set, delete a breakpoint\n"
+				<< "w <first> [last], wc          watch writes to memory (only Fx33/Fx55 write, reads are not watched), clear watches\n"
+				<< "if <Vx> <op> <value> [addr]   break when Vx op value (== != < >) at addr, or without addr when it becomes true\n"
+				<< "r, st, m <addr> [n]           registers, stack, memory\n"
+				<< "q                             quit\n";
+		}
+	}
+
+	return false;
+}
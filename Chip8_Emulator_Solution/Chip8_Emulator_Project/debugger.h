@@ -0,0 +1,80 @@
+#pragma once
+#include "chip8.h"
+#include <bitset>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+/*
+- Hooks object for Chip8::StepHooked / CycleHooked, the release loop never sees it
+- Breakpoints (and addresses with conditions) are one bit per address, so an unbroken run
+  costs one bitmap test per instruction
+- Watchpoints are checked only for the instructions that write memory (Fx33, Fx55); those are the only
+  instructions that write memory, so no write is missed, but nothing else (e.g. reads) can be watched
+- A condition with an address is checked every time that address runs. A condition on any address breaks when it
+  becomes true, not on every instruction it stays true, so continue gets past it
+*/
+
+enum DebugCompare
+{
+	COMPARE_EQUAL,
+	COMPARE_NOT_EQUAL,
+	COMPARE_LESS,
+	COMPARE_GREATER
+};
+
+//Break when V[reg] <compare> value, at address (or anywhere, once it becomes true, when any_address is set)
+struct DebugCondition
+{
+	uint16_t address;
+	bool any_address;
+	uint8_t reg;
+	DebugCompare compare;
+	uint8_t value;
+};
+
+class Debugger
+{
+public:
+	void AddBreakpoint(uint16_t address);
+	void RemoveBreakpoint(uint16_t address);
+	void AddCondition(DebugCondition const& condition);
+	//Break before any instruction writing memory in [first, last]
+	void AddWatchpoint(uint16_t first, uint16_t last);
+	void ClearWatchpoints();
+	//Break before the next instruction
+	void SingleStep();
+	//Run until the next break
+	void Continue();
+
+	bool BeforeExecute(Chip8 const& chip8, uint16_t address, uint16_t opcode);
+	//Why the last break happened
+	std::string const& Reason() const { return reason; }
+
+	void PrintRegisters(Chip8 const& chip8, std::ostream& out) const;
+	void PrintStack(Chip8 const& chip8, std::ostream& out) const;
+	void PrintMemory(Chip8 const& chip8, uint16_t first, uint16_t count, std::ostream& out) const;
+	void PrintInstruction(Chip8 const& chip8, uint16_t address, std::ostream& out) const;
+
+	//Console prompt while broken, returns false when the user quits
+	bool Prompt(Chip8 const& chip8);
+
+private:
+	bool CheckConditions(Chip8 const& chip8, uint16_t address);
+	void RebuildStops();
+
+	std::bitset<MEMORY_SIZE> breakpoints;
+	//breakpoints plus every address with a condition
+	std::bitset<MEMORY_SIZE> stops;
+	std::bitset<MEMORY_SIZE> watched;
+	std::vector<DebugCondition> conditions;
+	//Whether each condition held at the last instruction it was checked at, any_address conditions break on false -> true
+	std::vector<bool> conditions_held;
+	bool has_global_conditions{};
+	bool has_watchpoints{};
+	bool stepping{ true };
+	//Resuming from a break must not stop again on the same instruction
+	bool resuming{};
+	std::string reason{ "start" };
+};
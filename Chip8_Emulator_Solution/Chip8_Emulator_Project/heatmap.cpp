@@ -0,0 +1,80 @@
+#include "heatmap.h"
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+//Memory is drawn as a square of 64 x 64 addresses
+const unsigned int heatmap_width = 64;
+
+
+void MemoryHeatmap::Clear()
+{
+	memset(reads, 0, sizeof(reads));
+	memset(writes, 0, sizeof(writes));
+}
+
+bool MemoryHeatmap::WriteCsv(char const* file_name) const
+{
+	FILE* file = fopen(file_name, "w");
+
+	if (!file)
+	{
+		return false;
+	}
+
+	fprintf(file, "address,reads,writes\n");
+
+	for (unsigned int address = 0; address < MEMORY_SIZE; ++address)
+	{
+		if (reads[address] || writes[address])
+		{
+			fprintf(file, "0x%03X,%u,%u\n", address, reads[address], writes[address]);
+		}
+	}
+
+	return fclose(file) == 0;
+}
+
+//Counts span many orders of magnitude (a sprite drawn every frame vs a score written once), so brightness is log scaled
+static uint8_t Brightness(uint32_t count, double maxLog)
+{
+	if (count == 0 || maxLog <= 0.0)
+	{
+		return 0;
+	}
+
+	//Anything accessed at all stays visible
+	return static_cast<uint8_t>(55.0 + 200.0 * std::log(1.0 + count) / maxLog);
+}
+
+bool MemoryHeatmap::WritePpm(char const* file_name) const
+{
+	FILE* file = fopen(file_name, "wb");
+
+	if (!file)
+	{
+		return false;
+	}
+
+	uint32_t maxReads = 0;
+	uint32_t maxWrites = 0;
+
+	for (unsigned int address = 0; address < MEMORY_SIZE; ++address)
+	{
+		maxReads = reads[address] > maxReads ? reads[address] : maxReads;
+		maxWrites = writes[address] > maxWrites ? writes[address] : maxWrites;
+	}
+
+	double maxReadLog = std::log(1.0 + maxReads);
+	double maxWriteLog = std::log(1.0 + maxWrites);
+
+	fprintf(file, "P6\n%u %u\n255\n", heatmap_width, MEMORY_SIZE / heatmap_width);
+
+	for (unsigned int address = 0; address < MEMORY_SIZE; ++address)
+	{
+		uint8_t pixel[3] = { Brightness(writes[address], maxWriteLog), Brightness(reads[address], maxReadLog), 0 };
+		fwrite(pixel, 1, sizeof(pixel), file);
+	}
+
+	return fclose(file) == 0;
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include "chip8.h"
+#include <cstdint>
+
+/*
+- Per address counts of the memory accesses that matter for finding game variables:
+  reads by Fx65 (load registers) and Dxyn (sprite data), writes by Fx33 (BCD) and Fx55 (store registers)
+- Filled by a Chip8 given the heatmap with SetHeatmap, the counting costs nothing while it has none
+*/
+
+struct MemoryHeatmap
+{
+	uint32_t reads[MEMORY_SIZE]{};
+	uint32_t writes[MEMORY_SIZE]{};
+
+	void Clear();
+	//address,reads,writes per line (addresses never accessed are left out)
+	bool WriteCsv(char const* file_name) const;
+	//64x64 pixel image, address n is pixel n (row by row): reads in green, writes in red, log scaled
+	bool WritePpm(char const* file_name) const;
+};
@@ -0,0 +1,51 @@
+#include "input.h"
+
+
+static int64_t NowNanoseconds()
+{
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+void Input::Press(unsigned int key)
+{
+	{
+		//Taking the lock orders the press against a waiter that just found no keys down
+		std::lock_guard<std::mutex> lock(wait_mutex);
+		keys.fetch_or(static_cast<uint16_t>(1u << key), std::memory_order_release);
+	}
+
+	last_event_time.store(NowNanoseconds(), std::memory_order_release);
+
+	key_down.notify_all();
+}
+
+void Input::Release(unsigned int key)
+{
+	keys.fetch_and(static_cast<uint16_t>(~(1u << key)), std::memory_order_release);
+
+	last_event_time.store(NowNanoseconds(), std::memory_order_release);
+}
+
+uint16_t Input::WaitForKeys()
+{
+	std::unique_lock<std::mutex> lock(wait_mutex);
+	key_down.wait(lock, [this] { return stopped || Keys() != 0; });
+
+	return stopped ? 0 : Keys();
+}
+
+void Input::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(wait_mutex);
+		stopped = true;
+	}
+
+	key_down.notify_all();
+}
+
+uint16_t Input::WaitForKeys(void* context)
+{
+	return static_cast<Input*>(context)->WaitForKeys();
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+/*
+- Keypad state shared between the thread handling window events and the emulation thread
+- The 16 keys are one atomic mask (bit n = key n), reading it costs a single load
+- WaitForKeys lets Fx0A sleep until a key goes down instead of re-executing every cycle
+*/
+
+class Input
+{
+public:
+	void Press(unsigned int key);
+	void Release(unsigned int key);
+	uint16_t Keys() const { return keys.load(std::memory_order_acquire); }
+	//steady_clock time (nanoseconds since its epoch) of the last press or release, 0 before any
+	int64_t LastEventTime() const { return last_event_time.load(std::memory_order_acquire); }
+
+	//Blocks until at least one key is down, returns 0 once Stop was called
+	uint16_t WaitForKeys();
+	//Wakes every waiter for good (used when quitting)
+	void Stop();
+
+	//Matches Chip8::KeyWaitFunc, context is the Input
+	static uint16_t WaitForKeys(void* context);
+
+private:
+	std::atomic<uint16_t> keys{};
+	std::atomic<int64_t> last_event_time{};
+	std::mutex wait_mutex;
+	std::condition_variable key_down;
+	bool stopped{};
+};
@@ -1,49 +1,531 @@
 // Main of Chip8 - Emulator
 #include "chip8.h"
+#include "debugger.h"
+#include "heatmap.h"
+#include "input.h"
+#include "metrics.h"
 #include "platform.h"
+#include "recorder.h"
+#include "rom_cache.h"
+#include "rom_watcher.h"
+#include "vip_timing.h"
+#include <atomic>
 #include <chrono>
+#include <cstring>
+#include <functional>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+
+//Display frames (and the delay/sound timers) run at 60Hz
+const std::chrono::nanoseconds frame_time(1000000000 / 60);
+const float frame_time_ms = 1000.0f / 60.0f;
+//Instructions per frame when <Delay> is 0
+const unsigned int max_cycles_per_frame = 1000;
+//How often -metrics writes
+const std::chrono::milliseconds metrics_interval(5000);
+//How often the added host cost of run-ahead is printed (5 seconds)
+const unsigned int run_ahead_report_frames = 300;
+//How often warp mode measures its speed for the window title
+const std::chrono::milliseconds warp_speed_interval(500);
+const char window_title[] = "CHIP-8 Emulator";
+
+
+//<Delay> as instructions per 60Hz frame: the fraction is carried from frame to frame, so a delay longer than
+//a frame still runs 1000 / <Delay> instructions per second (every few frames one instruction)
+struct InstructionPacer
+{
+	double perFrame{};
+	double credit{};
+
+	//Instructions to run in the next frame
+	unsigned int Next()
+	{
+		credit += perFrame;
+		unsigned int cycles = static_cast<unsigned int>(credit);
+		credit -= cycles;
+
+		return cycles;
+	}
+};
+
+//Latest display handed from the emulation thread to the window thread
+struct FrameExchange
+{
+	std::mutex mutex;
+	uint32_t video[VIDEO_WIDTH * VIDEO_HEIGHT]{};
+	//Not yet presented
+	bool fresh{};
+	//Input::LastEventTime when the frame was finished
+	int64_t inputTime{};
+};
+
+struct Emulation
+{
+	Chip8 chip8;
+	Input input;
+	Recorder recorder;
+	Debugger debugger;
+	FrameExchange frame;
+	bool debug{};
+	InstructionPacer pacer;
+	//Frames emulated ahead of the real machine before presenting, 0 = off
+	unsigned int runAhead{};
+	Chip8 runAheadSnapshot;
+	EmulatorMetrics metrics;
+	//-hotreload: new versions of the ROM file are applied between frames
+	RomWatcher watcher;
+	bool reloadKeepState{};
+	//Toggled by the window thread: run uncapped and present at most once per display frame
+	std::atomic<bool> warp{};
+	//Emulated frames per real 60Hz frame while warping
+	std::atomic<float> warpSpeed{};
+	std::atomic<bool> quit{};
+	//-timing vip: instructions are paced by their COSMAC VIP cycle costs instead of the pacer
+	bool vipTiming{};
+	VipTiming timing;
+};
+
+
+//Hand the display to the window thread, a frame it has not presented yet counts as dropped
+static void PublishFrame(Emulation& emulation)
+{
+	FrameExchange& frame = emulation.frame;
+	std::lock_guard<std::mutex> lock(frame.mutex);
+
+	if (frame.fresh)
+	{
+		emulation.metrics.frames_dropped.Add();
+	}
+
+	memcpy(frame.video, emulation.chip8.video, sizeof(frame.video));
+	frame.fresh = true;
+	frame.inputTime = emulation.input.LastEventTime();
+}
+
+//Run-ahead: present the display N frames into the future (with the keys held now), then rewind
+//Games that react to a key a frame or more late show the reaction on the frame the key went down
+static void RunAhead(Emulation& emulation)
+{
+	Chip8& chip8 = emulation.chip8;
+	emulation.runAheadSnapshot = chip8;
+
+	//The future frames must never block waiting for a key, restoring the snapshot brings the key wait back
+	//(and the heatmap, frames that are thrown away are not counted)
+	chip8.SetKeyWait(nullptr, nullptr);
+	chip8.SetHeatmap(nullptr);
+
+	//The future frames use their own copy of the timing and the pacer, they are rewound with the machine
+	VipTiming timing = emulation.timing;
+	InstructionPacer pacer = emulation.pacer;
+
+	for (unsigned int frame = 0; frame < emulation.runAhead; ++frame)
+	{
+		unsigned int cycles = pacer.Next();
+
+		if (emulation.vipTiming)
+		{
+			chip8.RunFrameTimed(timing, cycles);
+		}
+		else
+		{
+			chip8.RunFrame(cycles);
+		}
+	}
+
+	PublishFrame(emulation);
+
+	chip8 = emulation.runAheadSnapshot;
+}
+
+//Runs the instructions of one frame that the timing policy admits, reading the keys before every instruction
+//Returns the number of instructions run, prompted is set when the debugger stopped at its prompt
+template <typename Timing>
+static unsigned int EmulateFrame(Emulation& emulation, Timing& timing, bool& prompted)
+{
+	Chip8& chip8 = emulation.chip8;
+	unsigned int executed = 0;
+
+	timing.BeginFrame(emulation.pacer.Next());
+
+	while (!emulation.quit)
+	{
+		chip8.keypad = emulation.input.Keys();
+
+		if (!timing.Admit(chip8, chip8.NextOpcode()))
+		{
+			break;
+		}
+
+		if (!emulation.debug)
+		{
+			chip8.StepSelected();
+		}
+		else if (!chip8.StepHooked(emulation.debugger))
+		{
+			prompted = true;
+
+			if (!emulation.debugger.Prompt(chip8))
+			{
+				emulation.quit = true;
+			}
+
+			continue;
+		}
+
+		timing.Charge();
+		++executed;
+	}
+
+	return executed;
+}
+
+//Runs on its own thread: the window thread only handles events and presents frames
+//Keys are read from the shared Input before every instruction, and Fx0A sleeps in Input::WaitForKeys
+static void EmulationLoop(Emulation& emulation, Platform& platform)
+{
+	Chip8& chip8 = emulation.chip8;
+	chip8.SetKeyWait(&Input::WaitForKeys, &emulation.input);
+
+	auto nextFrame = std::chrono::steady_clock::now();
+
+	//Host time spent emulating ahead, reported every few seconds
+	std::chrono::nanoseconds runAheadTime{};
+	unsigned int runAheadFrames = 0;
+
+	//Warp mode: emulated frames since the speed was last measured, and when the last frame was presented
+	bool warping = false;
+	unsigned int warpFrames = 0;
+	auto warpStart = nextFrame;
+	auto lastPresent = nextFrame;
+
+	while (!emulation.quit)
+	{
+		bool prompted = false;
+		auto frameStart = std::chrono::steady_clock::now();
+
+		//The watcher thread already loaded and analyzed the new version, applying it is a diff of at most 3.5KB
+		if (RomImage const* image = emulation.watcher.TakeChanged())
+		{
+			//The run-ahead snapshot is taken from chip8 again before it is used, so no machine keeps the old version
+			RomImage const* previous = chip8.Image();
+			unsigned int changed = chip8.reload_ROM(*image, emulation.reloadKeepState);
+			ReleaseRomImage(previous);
+			double reloadUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - frameStart).count();
+
+			std::cout << "ROM reloaded (" << (emulation.reloadKeepState ? "state kept" : "restarted") << "): "
+				<< changed << " bytes changed in " << reloadUs << " us\n";
+			PrintRomAnalysis(image->analysis, std::cout);
+		}
+
+		if (emulation.warp != warping)
+		{
+			warping = !warping;
+			warpFrames = 0;
+			warpStart = frameStart;
+			//Timers only ever tick once per emulated frame, so leaving warp just restarts the real time schedule
+			nextFrame = frameStart;
+		}
+
+		NoTiming counted;
+		unsigned int executed = emulation.vipTiming ? EmulateFrame(emulation, emulation.timing, prompted)
+			: EmulateFrame(emulation, counted, prompted);
+
+		chip8.TickTimers();
+
+		emulation.metrics.instructions.Add(executed);
+		emulation.metrics.frames_emulated.Add();
+		emulation.metrics.frame_time.Record(std::chrono::steady_clock::now() - frameStart);
+
+		emulation.recorder.Capture(chip8);
+
+		if (warping)
+		{
+			++warpFrames;
+
+			if (frameStart - warpStart >= warp_speed_interval)
+			{
+				emulation.warpSpeed = warpFrames * (frame_time.count() / static_cast<float>((frameStart - warpStart).count()));
+				warpFrames = 0;
+				warpStart = frameStart;
+			}
+
+			//Skip frames the display could not show anyway
+			if (frameStart - lastPresent >= frame_time)
+			{
+				lastPresent = frameStart;
+				PublishFrame(emulation);
+				platform.NotifyFrame();
+			}
+
+			if (prompted)
+			{
+				warpFrames = 0;
+				warpStart = std::chrono::steady_clock::now();
+			}
+
+			continue;
+		}
+
+		if (emulation.runAhead > 0 && !emulation.debug)
+		{
+			auto start = std::chrono::steady_clock::now();
+			RunAhead(emulation);
+			runAheadTime += std::chrono::steady_clock::now() - start;
+
+			if (++runAheadFrames == run_ahead_report_frames)
+			{
+				double perFrameUs = std::chrono::duration<double, std::micro>(runAheadTime).count() / runAheadFrames;
+
+				std::cout << "run-ahead " << emulation.runAhead << " frames: " << perFrameUs << " us per frame ("
+					<< perFrameUs / (frame_time_ms * 10.0) << "% of a frame)\n";
+
+				runAheadTime = std::chrono::nanoseconds{};
+				runAheadFrames = 0;
+			}
+		}
+		else
+		{
+			PublishFrame(emulation);
+		}
+
+		platform.NotifyFrame();
+
+		nextFrame += frame_time;
+		auto now = std::chrono::steady_clock::now();
+
+		if (prompted)
+		{
+			//Time spent at the debugger prompt does not count
+			nextFrame = now;
+		}
+		else if (now > nextFrame)
+		{
+			//Frames missed while blocked in Fx0A (or running late) still count down the timers
+			while (now > nextFrame + frame_time)
+			{
+				chip8.TickTimers();
+				nextFrame += frame_time;
+			}
+		}
+		else
+		{
+			std::this_thread::sleep_until(nextFrame);
+		}
+	}
+
+	//Wake the window thread so it notices the quit
+	platform.NotifyFrame();
+}
+
+
+static void ExitWithUsage(char const* program)
+{
+	std::cerr << "Usage: " << program << " <Scale> <Delay> <ROM> [-record <File>] [-debug] [-runahead <Frames>] [-metrics <File|->] [-hotreload keep|reset] [-heatmap <File.ppm|File.csv>] [-timing vip]\n";
+	std::exit(EXIT_FAILURE);
+}
 
 
 int main(int argc, char** argv)
 {
-	if (argc != 4)
+	if (argc < 4)
 	{
-		std::cerr << "Usage: " << argv[0] << " <Scale> <Delay> <ROM>\n";
-		std::exit(EXIT_FAILURE);
+		ExitWithUsage(argv[0]);
 	}
 
 	int videoScale = std::atoi(argv[1]);
 	int cycleDelay = std::atoi(argv[2]);
 	char const* romFilename = argv[3];
+	char const* recordFilename = nullptr;
+	char const* metricsFilename = nullptr;
+	char const* heatmapFilename = nullptr;
+	bool hotReload = false;
 
-	Platform platform("CHIP-8 Emulator", VIDEO_WIDTH * videoScale, VIDEO_HEIGHT * videoScale, VIDEO_WIDTH, VIDEO_HEIGHT);
+	Emulation emulation;
 
-	Chip8 chip8;
-	
-	chip8.open_ROM(romFilename);
+	for (int i = 4; i < argc; ++i)
+	{
+		if (std::strcmp(argv[i], "-record") == 0 && i + 1 < argc)
+		{
+			recordFilename = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "-debug") == 0)
+		{
+			emulation.debug = true;
+		}
+		else if (std::strcmp(argv[i], "-runahead") == 0 && i + 1 < argc)
+		{
+			emulation.runAhead = std::atoi(argv[++i]);
+		}
+		else if (std::strcmp(argv[i], "-metrics") == 0 && i + 1 < argc)
+		{
+			metricsFilename = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "-hotreload") == 0 && i + 1 < argc)
+		{
+			char const* mode = argv[++i];
+
+			//A misspelled mode must not quietly restart the machine on every change
+			if (std::strcmp(mode, "keep") != 0 && std::strcmp(mode, "reset") != 0)
+			{
+				std::cerr << "-hotreload takes keep or reset, not " << mode << "\n";
+				ExitWithUsage(argv[0]);
+			}
+
+			hotReload = true;
+			emulation.reloadKeepState = std::strcmp(mode, "keep") == 0;
+		}
+		else if (std::strcmp(argv[i], "-heatmap") == 0 && i + 1 < argc)
+		{
+			heatmapFilename = argv[++i];
+		}
+		else if (std::strcmp(argv[i], "-timing") == 0 && i + 1 < argc && std::strcmp(argv[i + 1], "vip") == 0)
+		{
+			emulation.vipTiming = true;
+			++i;
+		}
+		else
+		{
+			std::cerr << "Unknown option: " << argv[i] << "\n";
+			std::exit(EXIT_FAILURE);
+		}
+	}
+
+	//<Delay> is milliseconds per instruction, the emulation runs it as instructions per 60Hz frame
+	emulation.pacer.perFrame = cycleDelay > 0 ? frame_time_ms / cycleDelay : max_cycles_per_frame;
+
+	Platform platform(window_title, VIDEO_WIDTH * videoScale, VIDEO_HEIGHT * videoScale, VIDEO_WIDTH, VIDEO_HEIGHT);
+
+	if (!emulation.chip8.open_ROM(romFilename))
+	{
+		std::cerr << "Could not load ROM (missing or larger than " << ROM_MAX_SIZE << " bytes): " << romFilename << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	if (emulation.chip8.Image())
+	{
+		PrintRomAnalysis(emulation.chip8.Image()->analysis, std::cout);
+	}
+
+	if (hotReload)
+	{
+		emulation.watcher.Start(romFilename, emulation.chip8.Image());
+	}
+
+	//A different game every run, the cores are deterministic for a given seed
+	emulation.chip8.Seed(std::chrono::steady_clock::now().time_since_epoch().count());
+
+	//Memory accesses of the whole session, written at exit
+	std::unique_ptr<MemoryHeatmap> heatmap;
+
+	if (heatmapFilename)
+	{
+		heatmap.reset(new MemoryHeatmap());
+		emulation.chip8.SetHeatmap(heatmap.get());
+	}
+
+	if (recordFilename && !emulation.recorder.Open(recordFilename))
+	{
+		std::cerr << "Could not open recording file: " << recordFilename << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	int videoPitch = sizeof(emulation.chip8.video[0]) * VIDEO_WIDTH;
+	uint32_t video[VIDEO_WIDTH * VIDEO_HEIGHT]{};
+
+	MetricsWriter metricsWriter;
+
+	if (metricsFilename)
+	{
+		metricsWriter.Start(emulation.metrics, metricsFilename, metrics_interval);
+	}
 
-	int videoPitch = sizeof(chip8.video[0]) * VIDEO_WIDTH;
+	int64_t lastPresentedInput = 0;
+	float shownWarpSpeed = 0.0f;
 
-	auto lastCycleTime = std::chrono::high_resolution_clock::now();
-	bool quit = false;
+	std::thread emulationThread(EmulationLoop, std::ref(emulation), std::ref(platform));
 
-	while (!quit)
+	//Window thread: sleeps in WaitEvent, applies keys to Input immediately and presents new frames
+	while (!emulation.quit)
 	{
-		quit = platform.ProcessInput(chip8.keypad);
+		PlatformEvent event = platform.WaitEvent(emulation.input);
 
-		auto currentTime = std::chrono::high_resolution_clock::now();
-		float dt = std::chrono::duration<float, std::chrono::milliseconds::period>(currentTime - lastCycleTime).count();
+		if (event == PLATFORM_QUIT)
+		{
+			break;
+		}
+
+		if (event == PLATFORM_WARP)
+		{
+			emulation.warp = !emulation.warp;
+			emulation.warpSpeed = 0.0f;
+			shownWarpSpeed = 0.0f;
+			platform.SetTitle(emulation.warp ? (std::string(window_title) + " - warp").c_str() : window_title);
+		}
 
-		if (dt > cycleDelay)
+		if (event == PLATFORM_FRAME)
 		{
-			lastCycleTime = currentTime;
+			float warpSpeed = emulation.warpSpeed;
+
+			if (emulation.warp && warpSpeed != shownWarpSpeed)
+			{
+				shownWarpSpeed = warpSpeed;
+				platform.SetTitle((std::string(window_title) + " - warp " + std::to_string(static_cast<int>(warpSpeed + 0.5f)) + "x").c_str());
+			}
 
-			chip8.Cycle();
+			int64_t inputTime;
 
-			platform.Update(chip8.video, videoPitch);
+			{
+				std::lock_guard<std::mutex> lock(emulation.frame.mutex);
+				memcpy(video, emulation.frame.video, sizeof(video));
+				emulation.frame.fresh = false;
+				inputTime = emulation.frame.inputTime;
+			}
+
+			auto updateStart = std::chrono::steady_clock::now();
+			platform.Update(video, videoPitch);
+			auto presented = std::chrono::steady_clock::now();
+
+			emulation.metrics.update_duration.Record(presented - updateStart);
+			emulation.metrics.frames_presented.Add();
+
+			//First present of a frame that saw a new key event
+			if (inputTime != lastPresentedInput)
+			{
+				lastPresentedInput = inputTime;
+				int64_t presentedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(presented.time_since_epoch()).count();
+				emulation.metrics.input_to_present.Record(static_cast<uint64_t>(presentedNs - inputTime));
+			}
+		}
+	}
+
+	emulation.quit = true;
+	emulation.input.Stop();
+	emulationThread.join();
+
+	emulation.watcher.Stop();
+
+	emulation.recorder.Close();
+
+	if (uint64_t dropped = emulation.recorder.Dropped())
+	{
+		std::cout << "Recording: " << dropped << " frames dropped while the disk was busy (written as repeats)\n";
+	}
+	metricsWriter.Stop();
+
+	if (heatmap)
+	{
+		size_t length = std::strlen(heatmapFilename);
+		bool ppm = length >= 4 && std::strcmp(heatmapFilename + length - 4, ".ppm") == 0;
+
+		if (!(ppm ? heatmap->WritePpm(heatmapFilename) : heatmap->WriteCsv(heatmapFilename)))
+		{
+			std::cerr << "Could not write heatmap: " << heatmapFilename << "\n";
 		}
 	}
 
 	return 0;
-}
\ No newline at end of file
+}
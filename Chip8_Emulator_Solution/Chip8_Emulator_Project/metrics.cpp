@@ -0,0 +1,240 @@
+#include "metrics.h"
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#endif
+
+
+//Values below 16 get their own bucket, above that the top 5 bits pick the bucket
+unsigned int MetricsHistogram::BucketIndex(uint64_t value)
+{
+	if (value < HISTOGRAM_SUB_BUCKETS)
+	{
+		return static_cast<unsigned int>(value);
+	}
+
+#ifdef _MSC_VER
+	unsigned long msb;
+	_BitScanReverse64(&msb, value);
+#else
+	unsigned int msb = 63 - __builtin_clzll(value);
+#endif
+
+	unsigned int exponent = msb - HISTOGRAM_SUB_BITS + 1;
+	unsigned int sub = static_cast<unsigned int>(value >> (exponent - 1)) & (HISTOGRAM_SUB_BUCKETS - 1);
+	unsigned int index = exponent * HISTOGRAM_SUB_BUCKETS + sub;
+
+	return index < HISTOGRAM_BUCKETS ? index : HISTOGRAM_BUCKETS - 1;
+}
+
+uint64_t MetricsHistogram::BucketUpperBound(unsigned int index)
+{
+	unsigned int exponent = index / HISTOGRAM_SUB_BUCKETS;
+	unsigned int sub = index % HISTOGRAM_SUB_BUCKETS;
+
+	if (exponent == 0)
+	{
+		return sub;
+	}
+
+	return ((uint64_t(HISTOGRAM_SUB_BUCKETS + sub + 1)) << (exponent - 1)) - 1;
+}
+
+void MetricsHistogram::Record(uint64_t value)
+{
+	buckets[BucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+	count.fetch_add(1, std::memory_order_relaxed);
+	sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+uint64_t MetricsHistogram::Quantile(double quantile) const
+{
+	uint64_t total = 0;
+	uint64_t counts[HISTOGRAM_BUCKETS];
+
+	for (unsigned int i = 0; i < HISTOGRAM_BUCKETS; ++i)
+	{
+		counts[i] = buckets[i].load(std::memory_order_relaxed);
+		total += counts[i];
+	}
+
+	if (total == 0)
+	{
+		return 0;
+	}
+
+	uint64_t target = static_cast<uint64_t>(quantile * (total - 1)) + 1;
+	uint64_t seen = 0;
+
+	for (unsigned int i = 0; i < HISTOGRAM_BUCKETS; ++i)
+	{
+		seen += counts[i];
+
+		if (seen >= target)
+		{
+			return BucketUpperBound(i);
+		}
+	}
+
+	return BucketUpperBound(HISTOGRAM_BUCKETS - 1);
+}
+
+uint64_t MetricsHistogram::CountAtMost(uint64_t bound) const
+{
+	uint64_t total = 0;
+
+	for (unsigned int i = 0; i < HISTOGRAM_BUCKETS && BucketUpperBound(i) <= bound; ++i)
+	{
+		total += buckets[i].load(std::memory_order_relaxed);
+	}
+
+	return total;
+}
+
+
+MetricsWriter::~MetricsWriter()
+{
+	Stop();
+}
+
+void MetricsWriter::Start(EmulatorMetrics const& metrics_to_write, std::string const& file, std::chrono::milliseconds every)
+{
+	metrics = &metrics_to_write;
+	file_name = file;
+	interval = every;
+	start_time = std::chrono::steady_clock::now();
+	stopping = false;
+
+	writer = std::thread(&MetricsWriter::WriterLoop, this);
+}
+
+void MetricsWriter::Stop()
+{
+	if (!writer.joinable())
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(stop_mutex);
+		stopping = true;
+	}
+
+	stop_signal.notify_one();
+	writer.join();
+
+	//Final values on the way out
+	Write();
+}
+
+void MetricsWriter::WriterLoop()
+{
+	std::unique_lock<std::mutex> lock(stop_mutex);
+
+	while (!stop_signal.wait_for(lock, interval, [this] { return stopping; }))
+	{
+		Write();
+	}
+}
+
+void MetricsWriter::Write()
+{
+	double uptime = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+	std::string text = Format(*metrics, uptime);
+
+	if (file_name == "-")
+	{
+		std::cout << text << std::flush;
+		return;
+	}
+
+	//Write then rename over the old file, so a scraper never reads half a file or finds none
+	std::string temporary = file_name + ".tmp";
+	FILE* file = fopen(temporary.c_str(), "wb");
+
+	if (!file)
+	{
+		return;
+	}
+
+	bool written = fwrite(text.data(), 1, text.size(), file) == text.size();
+
+	//A short write (full disk) keeps the last complete file
+	if (fclose(file) != 0 || !written)
+	{
+		std::remove(temporary.c_str());
+		return;
+	}
+
+#ifdef _WIN32
+	//rename fails on Windows when the target exists
+	MoveFileExA(temporary.c_str(), file_name.c_str(), MOVEFILE_REPLACE_EXISTING);
+#else
+	std::rename(temporary.c_str(), file_name.c_str());
+#endif
+}
+
+static void FormatCounter(std::ostream& out, char const* name, char const* help, uint64_t value)
+{
+	out << "# HELP " << name << " " << help << "\n"
+		<< "# TYPE " << name << " counter\n"
+		<< name << " " << value << "\n";
+}
+
+//Exported with power of two buckets in seconds, plus the fine grained quantiles as a summary
+static void FormatHistogram(std::ostream& out, char const* name, char const* help, MetricsHistogram const& histogram)
+{
+	out << "# HELP " << name << "_seconds " << help << "\n"
+		<< "# TYPE " << name << "_seconds histogram\n";
+
+	for (unsigned int power = 10; power <= 34; power += 2)
+	{
+		uint64_t bound = (1ull << power) - 1;
+		out << name << "_seconds_bucket{le=\"" << bound * 1e-9 << "\"} " << histogram.CountAtMost(bound) << "\n";
+	}
+
+	out << name << "_seconds_bucket{le=\"+Inf\"} " << histogram.Count() << "\n"
+		<< name << "_seconds_sum " << histogram.Sum() * 1e-9 << "\n"
+		<< name << "_seconds_count " << histogram.Count() << "\n";
+
+	out << "# TYPE " << name << "_quantile_seconds gauge\n";
+
+	double const quantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+	for (double quantile : quantiles)
+	{
+		out << name << "_quantile_seconds{quantile=\"" << quantile << "\"} " << histogram.Quantile(quantile) * 1e-9 << "\n";
+	}
+}
+
+std::string MetricsWriter::Format(EmulatorMetrics const& metrics, double uptime_seconds)
+{
+	std::ostringstream out;
+
+	FormatCounter(out, "chip8_instructions_total", "Emulated instructions.", metrics.instructions.Get());
+	FormatCounter(out, "chip8_frames_emulated_total", "Emulated 60Hz frames.", metrics.frames_emulated.Get());
+	FormatCounter(out, "chip8_frames_presented_total", "Frames presented in the window.", metrics.frames_presented.Get());
+	FormatCounter(out, "chip8_frames_dropped_total", "Emulated frames replaced before being presented.", metrics.frames_dropped.Get());
+
+	out << "# HELP chip8_instructions_per_second Emulated instructions per second since start.\n"
+		<< "# TYPE chip8_instructions_per_second gauge\n"
+		<< "chip8_instructions_per_second " << (uptime_seconds > 0 ? metrics.instructions.Get() / uptime_seconds : 0) << "\n";
+
+	out << "# HELP chip8_emulation_speed Emulated frames per 60Hz of wall time (1 = real time).\n"
+		<< "# TYPE chip8_emulation_speed gauge\n"
+		<< "chip8_emulation_speed " << (uptime_seconds > 0 ? metrics.frames_emulated.Get() / (uptime_seconds * 60.0) : 0) << "\n";
+
+	FormatHistogram(out, "chip8_frame_time", "Host time to emulate one frame.", metrics.frame_time);
+	FormatHistogram(out, "chip8_update_duration", "Host time in Platform::Update.", metrics.update_duration);
+	FormatHistogram(out, "chip8_input_to_present", "Key event to present of the first frame that saw it.", metrics.input_to_present);
+
+	return out.str();
+}
@@ -0,0 +1,92 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+/*
+- Counters and histograms that are cheap enough to leave on: recording is one relaxed atomic add
+- Histograms are log-linear (HDR style): 16 linear sub-buckets per power of two, so any value is
+  within 1/16 (~6%) of its bucket, from 1ns up to 2^47ns (~39 hours)
+- A background thread writes everything in Prometheus text exposition format to a file (or stdout)
+*/
+
+class MetricsCounter
+{
+public:
+	void Add(uint64_t amount = 1) { value.fetch_add(amount, std::memory_order_relaxed); }
+	uint64_t Get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+	std::atomic<uint64_t> value{};
+};
+
+const unsigned int HISTOGRAM_SUB_BITS = 4;
+const unsigned int HISTOGRAM_SUB_BUCKETS = 1u << HISTOGRAM_SUB_BITS;
+const unsigned int HISTOGRAM_EXPONENTS = 44;
+const unsigned int HISTOGRAM_BUCKETS = HISTOGRAM_EXPONENTS * HISTOGRAM_SUB_BUCKETS;
+
+class MetricsHistogram
+{
+public:
+	void Record(uint64_t value);
+	void Record(std::chrono::nanoseconds duration) { Record(static_cast<uint64_t>(duration.count() < 0 ? 0 : duration.count())); }
+
+	uint64_t Count() const { return count.load(std::memory_order_relaxed); }
+	uint64_t Sum() const { return sum.load(std::memory_order_relaxed); }
+	//Upper bound of the bucket holding the given quantile (0 - 1)
+	uint64_t Quantile(double quantile) const;
+	//Count of recorded values <= bound, bound must be a power of two
+	uint64_t CountAtMost(uint64_t bound) const;
+
+	static unsigned int BucketIndex(uint64_t value);
+	static uint64_t BucketUpperBound(unsigned int index);
+
+private:
+	std::atomic<uint64_t> buckets[HISTOGRAM_BUCKETS]{};
+	std::atomic<uint64_t> count{};
+	std::atomic<uint64_t> sum{};
+};
+
+//Everything the emulator reports
+struct EmulatorMetrics
+{
+	MetricsCounter instructions;
+	MetricsCounter frames_emulated;
+	MetricsCounter frames_presented;
+	//Emulated frames replaced before the window thread presented them
+	MetricsCounter frames_dropped;
+	//Host time to emulate one frame
+	MetricsHistogram frame_time;
+	//Host time inside Platform::Update
+	MetricsHistogram update_duration;
+	//Key event to the present of the first frame that saw it
+	MetricsHistogram input_to_present;
+};
+
+class MetricsWriter
+{
+public:
+	~MetricsWriter();
+	//file_name "-" writes to stdout, otherwise the file is replaced on every write
+	void Start(EmulatorMetrics const& metrics, std::string const& file_name, std::chrono::milliseconds interval);
+	void Stop();
+	//Prometheus text for the current values
+	static std::string Format(EmulatorMetrics const& metrics, double uptime_seconds);
+
+private:
+	void WriterLoop();
+	void Write();
+
+	EmulatorMetrics const* metrics{};
+	std::string file_name;
+	std::chrono::milliseconds interval{};
+	std::chrono::steady_clock::time_point start_time;
+	std::thread writer;
+	std::mutex stop_mutex;
+	std::condition_variable stop_signal;
+	bool stopping{};
+};
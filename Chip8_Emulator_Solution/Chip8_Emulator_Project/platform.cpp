@@ -1,7 +1,42 @@
 #include "platform.h"
+#include "input.h"
 #include <SDL.h>
 
 
+//SDL keycode -> CHIP-8 key, -1 for keys that are not on the keypad
+//The keypad keycodes are all ASCII, so a 128 entry table covers them
+//	1 2 3 C        1 2 3 4
+//	4 5 6 D   <-   Q W E R
+//	7 8 9 E        A S D F
+//	A 0 B F        Z X C V
+static int8_t key_map[128];
+
+static void BuildKeyMap()
+{
+	static const SDL_Keycode keys[16] = {
+		SDLK_x, SDLK_1, SDLK_2, SDLK_3,
+		SDLK_q, SDLK_w, SDLK_e, SDLK_a,
+		SDLK_s, SDLK_d, SDLK_z, SDLK_c,
+		SDLK_4, SDLK_r, SDLK_f, SDLK_v
+	};
+
+	for (int8_t& entry : key_map)
+	{
+		entry = -1;
+	}
+
+	for (int8_t key = 0; key < 16; ++key)
+	{
+		key_map[keys[key]] = key;
+	}
+}
+
+static int MapKey(SDL_Keycode keycode)
+{
+	return (keycode >= 0 && keycode < 128) ? key_map[keycode] : -1;
+}
+
+
 Platform::Platform(char const* title, int windowWidth, int windowHeight, int textureWidth, int textureHeight)
 {
 	SDL_Init(SDL_INIT_VIDEO);
@@ -12,6 +47,10 @@ Platform::Platform(char const* title, int windowWidth, int windowHeight, int tex
 
 	texture = SDL_CreateTexture(
 		renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, textureWidth, textureHeight);
+
+	frame_event = SDL_RegisterEvents(1);
+
+	BuildKeyMap();
 }
 
 Platform::~Platform()
@@ -25,204 +64,106 @@ Platform::~Platform()
 void Platform::Update(void const* buffer, int pitch)
 {
 	SDL_UpdateTexture(texture, nullptr, buffer, pitch);
+	Present();
+}
+
+void Platform::UpdateRegion(int x, int y, int width, int height, void const* buffer, int pitch)
+{
+	SDL_Rect rect{ x, y, width, height };
+	SDL_UpdateTexture(texture, &rect, buffer, pitch);
+}
+
+void Platform::Present()
+{
 	SDL_RenderClear(renderer);
 	SDL_RenderCopy(renderer, texture, nullptr, nullptr);
 	SDL_RenderPresent(renderer);
 }
 
-bool Platform::ProcessInput(uint8_t* keys)
+void Platform::NotifyFrame()
+{
+	SDL_Event event{};
+	event.type = frame_event;
+	SDL_PushEvent(&event);
+}
+
+void Platform::SetTitle(char const* title)
 {
-	bool quit = false;
+	SDL_SetWindowTitle(window, title);
+}
+
+PlatformEvent Platform::WaitEvent(Input& input)
+{
+	SDL_Event event;
+
+	if (!SDL_WaitEvent(&event))
+	{
+		return PLATFORM_NONE;
+	}
+
+	return HandleEvent(event, input);
+}
 
+PlatformEvent Platform::PollEvents(Input& input)
+{
 	SDL_Event event;
+	PlatformEvent result = PLATFORM_NONE;
 
 	while (SDL_PollEvent(&event))
 	{
-		switch (event.type)
+		if (HandleEvent(event, input) == PLATFORM_QUIT)
 		{
-		case SDL_QUIT:
+			result = PLATFORM_QUIT;
+		}
+	}
+
+	return result;
+}
+
+PlatformEvent Platform::HandleEvent(SDL_Event const& event, Input& input)
+{
+	if (event.type == frame_event)
+	{
+		return PLATFORM_FRAME;
+	}
+
+	switch (event.type)
+	{
+	case SDL_QUIT:
+	{
+		return PLATFORM_QUIT;
+	}
+
+	case SDL_KEYDOWN:
+	{
+		if (event.key.keysym.sym == SDLK_ESCAPE)
+		{
+			return PLATFORM_QUIT;
+		}
+
+		if (event.key.keysym.sym == SDLK_TAB)
 		{
-			quit = true;
-		} break;
+			return event.key.repeat ? PLATFORM_NONE : PLATFORM_WARP;
+		}
+
+		int key = MapKey(event.key.keysym.sym);
 
-		case SDL_KEYDOWN:
+		if (key >= 0)
 		{
-			switch (event.key.keysym.sym)
-			{
-			case SDLK_ESCAPE:
-			{
-				quit = true;
-			} break;
-
-			case SDLK_x:
-			{
-				keys[0] = 1;
-			} break;
-
-			case SDLK_1:
-			{
-				keys[1] = 1;
-			} break;
-
-			case SDLK_2:
-			{
-				keys[2] = 1;
-			} break;
-
-			case SDLK_3:
-			{
-				keys[3] = 1;
-			} break;
-
-			case SDLK_q:
-			{
-				keys[4] = 1;
-			} break;
-
-			case SDLK_w:
-			{
-				keys[5] = 1;
-			} break;
-
-			case SDLK_e:
-			{
-				keys[6] = 1;
-			} break;
-
-			case SDLK_a:
-			{
-				keys[7] = 1;
-			} break;
-
-			case SDLK_s:
-			{
-				keys[8] = 1;
-			} break;
-
-			case SDLK_d:
-			{
-				keys[9] = 1;
-			} break;
-
-			case SDLK_z:
-			{
-				keys[0xA] = 1;
-			} break;
-
-			case SDLK_c:
-			{
-				keys[0xB] = 1;
-			} break;
-
-			case SDLK_4:
-			{
-				keys[0xC] = 1;
-			} break;
-
-			case SDLK_r:
-			{
-				keys[0xD] = 1;
-			} break;
-
-			case SDLK_f:
-			{
-				keys[0xE] = 1;
-			} break;
-
-			case SDLK_v:
-			{
-				keys[0xF] = 1;
-			} break;
-			}
-		} break;
-
-		case SDL_KEYUP:
+			input.Press(key);
+		}
+	} break;
+
+	case SDL_KEYUP:
+	{
+		int key = MapKey(event.key.keysym.sym);
+
+		if (key >= 0)
 		{
-			switch (event.key.keysym.sym)
-			{
-			case SDLK_x:
-			{
-				keys[0] = 0;
-			} break;
-
-			case SDLK_1:
-			{
-				keys[1] = 0;
-			} break;
-
-			case SDLK_2:
-			{
-				keys[2] = 0;
-			} break;
-
-			case SDLK_3:
-			{
-				keys[3] = 0;
-			} break;
-
-			case SDLK_q:
-			{
-				keys[4] = 0;
-			} break;
-
-			case SDLK_w:
-			{
-				keys[5] = 0;
-			} break;
-
-			case SDLK_e:
-			{
-				keys[6] = 0;
-			} break;
-
-			case SDLK_a:
-			{
-				keys[7] = 0;
-			} break;
-
-			case SDLK_s:
-			{
-				keys[8] = 0;
-			} break;
-
-			case SDLK_d:
-			{
-				keys[9] = 0;
-			} break;
-
-			case SDLK_z:
-			{
-				keys[0xA] = 0;
-			} break;
-
-			case SDLK_c:
-			{
-				keys[0xB] = 0;
-			} break;
-
-			case SDLK_4:
-			{
-				keys[0xC] = 0;
-			} break;
-
-			case SDLK_r:
-			{
-				keys[0xD] = 0;
-			} break;
-
-			case SDLK_f:
-			{
-				keys[0xE] = 0;
-			} break;
-
-			case SDLK_v:
-			{
-				keys[0xF] = 0;
-			} break;
-			}
-		} break;
+			input.Release(key);
 		}
+	} break;
 	}
 
-	return quit;
-}
\ No newline at end of file
+	return PLATFORM_NONE;
+}
@@ -5,18 +5,43 @@
 class SDL_Window;
 class SDL_Renderer;
 class SDL_Texture;
+union SDL_Event;
+class Input;
 
 
+//What woke WaitEvent up
+enum PlatformEvent
+{
+	PLATFORM_NONE,
+	PLATFORM_QUIT,
+	PLATFORM_FRAME,
+	//TAB toggles warp mode
+	PLATFORM_WARP
+};
+
 class Platform
 {
 public:
 	Platform(char const* title, int windowWidth, int windowHeight, int textureWidth, int textureHeight);
 	~Platform();
 	void Update(void const* buffer, int pitch);
-	bool ProcessInput(uint8_t* keys);
+	//Uploads one rectangle of the texture, Present shows everything uploaded so far
+	void UpdateRegion(int x, int y, int width, int height, void const* buffer, int pitch);
+	void Present();
+	//Sleeps until the next window event, key events are applied to input as they arrive
+	PlatformEvent WaitEvent(Input& input);
+	//Handles every pending event without sleeping, PLATFORM_QUIT if one of them asked to quit
+	PlatformEvent PollEvents(Input& input);
+	//Can be called from any thread, makes WaitEvent return PLATFORM_FRAME
+	void NotifyFrame();
+	//Window thread only
+	void SetTitle(char const* title);
 
 private:
+	PlatformEvent HandleEvent(SDL_Event const& event, Input& input);
+
 	SDL_Window* window{};
 	SDL_Renderer* renderer{};
 	SDL_Texture* texture{};
-};
\ No newline at end of file
+	uint32_t frame_event{};
+};
@@ -0,0 +1,118 @@
+#include "ram_search.h"
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RAM_SEARCH_SSE2
+#include <emmintrin.h>
+#endif
+
+
+RamSearch::RamSearch()
+{
+	Reset();
+}
+
+void RamSearch::Reset()
+{
+	memset(candidates, 0xFF, sizeof(candidates));
+}
+
+#ifdef RAM_SEARCH_SSE2
+
+//SSE2 only compares signed bytes, flipping the top bit turns that into an unsigned compare
+template <SearchCompare Compare>
+static inline __m128i Matches(__m128i previous, __m128i current)
+{
+	const __m128i sign = _mm_set1_epi8(static_cast<char>(0x80));
+
+	switch (Compare)
+	{
+	case SEARCH_EQUAL:
+		return _mm_cmpeq_epi8(current, previous);
+	case SEARCH_CHANGED:
+		return _mm_andnot_si128(_mm_cmpeq_epi8(current, previous), _mm_set1_epi8(-1));
+	case SEARCH_INCREASED:
+		return _mm_cmpgt_epi8(_mm_xor_si128(current, sign), _mm_xor_si128(previous, sign));
+	default:
+		return _mm_cmpgt_epi8(_mm_xor_si128(previous, sign), _mm_xor_si128(current, sign));
+	}
+}
+
+template <SearchCompare Compare>
+static void Filter(uint8_t* candidates, uint8_t const* previous, uint8_t const* current)
+{
+	for (unsigned int i = 0; i < MEMORY_SIZE; i += 16)
+	{
+		__m128i before = _mm_loadu_si128(reinterpret_cast<__m128i const*>(&previous[i]));
+		__m128i after = _mm_loadu_si128(reinterpret_cast<__m128i const*>(&current[i]));
+		__m128i* kept = reinterpret_cast<__m128i*>(&candidates[i]);
+
+		_mm_store_si128(kept, _mm_and_si128(_mm_load_si128(kept), Matches<Compare>(before, after)));
+	}
+}
+
+#else
+
+template <SearchCompare Compare>
+static void Filter(uint8_t* candidates, uint8_t const* previous, uint8_t const* current)
+{
+	for (unsigned int i = 0; i < MEMORY_SIZE; ++i)
+	{
+		bool match;
+
+		switch (Compare)
+		{
+		case SEARCH_EQUAL: match = current[i] == previous[i]; break;
+		case SEARCH_CHANGED: match = current[i] != previous[i]; break;
+		case SEARCH_INCREASED: match = current[i] > previous[i]; break;
+		default: match = current[i] < previous[i]; break;
+		}
+
+		candidates[i] &= match ? 0xFF : 0x00;
+	}
+}
+
+#endif
+
+void RamSearch::Compare(uint8_t const* previous, uint8_t const* current, SearchCompare compare)
+{
+	switch (compare)
+	{
+	case SEARCH_EQUAL: Filter<SEARCH_EQUAL>(candidates, previous, current); break;
+	case SEARCH_CHANGED: Filter<SEARCH_CHANGED>(candidates, previous, current); break;
+	case SEARCH_INCREASED: Filter<SEARCH_INCREASED>(candidates, previous, current); break;
+	case SEARCH_DECREASED: Filter<SEARCH_DECREASED>(candidates, previous, current); break;
+	}
+}
+
+void RamSearch::CompareValue(uint8_t const* current, SearchCompare compare, uint8_t value)
+{
+	uint8_t values[MEMORY_SIZE];
+	memset(values, value, sizeof(values));
+
+	Compare(values, current, compare);
+}
+
+unsigned int RamSearch::Count() const
+{
+	unsigned int count = 0;
+
+#ifdef RAM_SEARCH_SSE2
+	for (unsigned int i = 0; i < MEMORY_SIZE; i += 16)
+	{
+		unsigned int mask = _mm_movemask_epi8(_mm_load_si128(reinterpret_cast<__m128i const*>(&candidates[i])));
+
+		for (; mask; mask &= mask - 1)
+		{
+			++count;
+		}
+	}
+#else
+	for (uint8_t candidate : candidates)
+	{
+		count += candidate != 0;
+	}
+#endif
+
+	return count;
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "chip8.h"
+#include <cstdint>
+
+/*
+- Narrows down which of the 4096 addresses hold a game variable (score, lives, position)
+- Every address starts as a candidate, each filter keeps the ones whose values compare as asked
+- A filter runs over all of memory with 16 byte SSE2 compares (scalar elsewhere), so filtering
+  thousands of machines (one Compare per machine) is bound by reading their memory
+*/
+
+enum SearchCompare
+{
+	SEARCH_EQUAL,
+	SEARCH_CHANGED,
+	//Unsigned bytes
+	SEARCH_INCREASED,
+	SEARCH_DECREASED
+};
+
+class RamSearch
+{
+public:
+	RamSearch();
+	//Every address is a candidate again
+	void Reset();
+	//Keep the candidates where current <compare> previous (both MEMORY_SIZE bytes, e.g. Chip8::Memory of two snapshots)
+	void Compare(uint8_t const* previous, uint8_t const* current, SearchCompare compare);
+	//Keep the candidates where current <compare> value (changed = not equal, increased = greater, decreased = less)
+	void CompareValue(uint8_t const* current, SearchCompare compare, uint8_t value);
+	unsigned int Count() const;
+	bool IsCandidate(unsigned int address) const { return candidates[address & (MEMORY_SIZE - 1)] != 0; }
+
+private:
+	//0xFF for candidates, 0 for the rest
+	alignas(16) uint8_t candidates[MEMORY_SIZE];
+};
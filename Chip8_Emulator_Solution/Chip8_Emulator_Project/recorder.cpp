@@ -0,0 +1,347 @@
+#include "recorder.h"
+#include <cstring>
+
+//Frames are 256 bytes copied into a fixed ring, so the emulation thread never allocates and only waits on the
+//disk while the ring is full
+//The writer thread XORs each frame against the previous one and only stores rows that changed
+
+static const char recording_magic[4] = { 'C', '8', 'R', 'V' };
+
+
+Recorder::Recorder()
+{}
+
+Recorder::~Recorder()
+{
+	Close();
+}
+
+bool Recorder::Open(char const* file_name)
+{
+	//Assigning to a joinable writer would terminate
+	if (file || writer.joinable())
+	{
+		return false;
+	}
+
+	file = fopen(file_name, "wb");
+
+	if (!file)
+	{
+		return false;
+	}
+
+	uint8_t header[7] = { 0, 0, 0, 0, RECORDING_VERSION, VIDEO_WIDTH, VIDEO_HEIGHT };
+	memcpy(header, recording_magic, sizeof(recording_magic));
+	fwrite(header, 1, sizeof(header), file);
+
+	memset(previous, 0, sizeof(previous));
+	ring.resize(RECORDER_QUEUE_FRAMES);
+	ring_head = 0;
+	ring_count = 0;
+	dropped = 0;
+	stalled = false;
+	closing = false;
+	writer = std::thread(&Recorder::WriterLoop, this);
+
+	return true;
+}
+
+void Recorder::Capture(Chip8 const& chip8)
+{
+	if (!file)
+	{
+		return;
+	}
+
+	uint8_t packed[VIDEO_PACKED_SIZE];
+	chip8.PackVideo(packed);
+
+	{
+		std::unique_lock<std::mutex> lock(queue_mutex);
+
+		if (ring_count == ring.size() && !stalled)
+		{
+			stalled = !queue_space.wait_for(lock, RECORDER_STALL_TIMEOUT, [this] { return ring_count != ring.size(); });
+		}
+
+		if (ring_count == ring.size())
+		{
+			++ring[(ring_head + ring_count - 1) % ring.size()].repeats;
+			++dropped;
+		}
+		else
+		{
+			QueuedFrame& slot = ring[(ring_head + ring_count) % ring.size()];
+			memcpy(slot.packed, packed, VIDEO_PACKED_SIZE);
+			slot.repeats = 0;
+			++ring_count;
+		}
+	}
+
+	queue_ready.notify_one();
+}
+
+uint64_t Recorder::Dropped()
+{
+	std::lock_guard<std::mutex> lock(queue_mutex);
+	return dropped;
+}
+
+void Recorder::Close()
+{
+	if (!file)
+	{
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(queue_mutex);
+		closing = true;
+	}
+
+	queue_ready.notify_one();
+	writer.join();
+
+	fclose(file);
+	file = nullptr;
+}
+
+void Recorder::WriterLoop()
+{
+	QueuedFrame frame;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(queue_mutex);
+			queue_ready.wait(lock, [this] { return closing || ring_count != 0; });
+
+			if (ring_count == 0)
+			{
+				//Closing and nothing left to write
+				break;
+			}
+
+			frame = ring[ring_head];
+			ring_head = (ring_head + 1) % ring.size();
+			--ring_count;
+			stalled = false;
+		}
+
+		queue_space.notify_one();
+
+		Encode(frame.packed);
+
+		for (uint32_t repeat = 0; repeat < frame.repeats; ++repeat)
+		{
+			fputc(RECORD_SAME_FRAME, file);
+		}
+	}
+
+	fflush(file);
+}
+
+void Recorder::Encode(uint8_t const* frame)
+{
+	uint8_t delta[VIDEO_PACKED_SIZE];
+	uint32_t changed_rows = 0;
+	unsigned int delta_size = 0;
+
+	//Collect the XOR of every changed row
+	for (unsigned int row = 0; row < VIDEO_HEIGHT; ++row)
+	{
+		uint8_t const* current = &frame[row * VIDEO_ROW_BYTES];
+		uint8_t const* last = &previous[row * VIDEO_ROW_BYTES];
+
+		if (memcmp(current, last, VIDEO_ROW_BYTES) == 0)
+		{
+			continue;
+		}
+
+		changed_rows |= (1u << row);
+
+		for (unsigned int i = 0; i < VIDEO_ROW_BYTES; ++i)
+		{
+			delta[delta_size++] = current[i] ^ last[i];
+		}
+	}
+
+	if (changed_rows == 0)
+	{
+		fputc(RECORD_SAME_FRAME, file);
+		return;
+	}
+
+	encoded.clear();
+	encoded.push_back(RECORD_DELTA_FRAME);
+	encoded.push_back(changed_rows & 0xFFu);
+	encoded.push_back((changed_rows >> 8u) & 0xFFu);
+	encoded.push_back((changed_rows >> 16u) & 0xFFu);
+	encoded.push_back((changed_rows >> 24u) & 0xFFu);
+
+	//Run length encode the delta, XOR of mostly unchanged rows is mostly zeroes
+	unsigned int i = 0;
+
+	while (i < delta_size)
+	{
+		unsigned int run = 0;
+
+		while (i + run < delta_size && delta[i + run] == 0 && run < 128)
+		{
+			++run;
+		}
+
+		if (run > 0)
+		{
+			encoded.push_back(0x80u | (run - 1));
+			i += run;
+			continue;
+		}
+
+		//Literal bytes continue until the next zero byte
+		unsigned int count = 0;
+
+		while (i + count < delta_size && delta[i + count] != 0 && count < 128)
+		{
+			++count;
+		}
+
+		encoded.push_back(count - 1);
+		encoded.insert(encoded.end(), &delta[i], &delta[i + count]);
+		i += count;
+	}
+
+	fwrite(encoded.data(), 1, encoded.size(), file);
+
+	memcpy(previous, frame, VIDEO_PACKED_SIZE);
+}
+
+
+RecordingReader::~RecordingReader()
+{
+	if (file)
+	{
+		fclose(file);
+	}
+}
+
+bool RecordingReader::Open(char const* file_name)
+{
+	file = fopen(file_name, "rb");
+
+	if (!file)
+	{
+		return false;
+	}
+
+	uint8_t header[7];
+
+	if (fread(header, 1, sizeof(header), file) != sizeof(header)
+		|| memcmp(header, recording_magic, sizeof(recording_magic)) != 0
+		|| header[4] != RECORDING_VERSION
+		|| header[5] != VIDEO_WIDTH
+		|| header[6] != VIDEO_HEIGHT)
+	{
+		fclose(file);
+		file = nullptr;
+		return false;
+	}
+
+	memset(current, 0, sizeof(current));
+
+	return true;
+}
+
+bool RecordingReader::NextFrame(uint8_t* packed)
+{
+	if (!file)
+	{
+		return false;
+	}
+
+	int tag = fgetc(file);
+
+	if (tag == EOF)
+	{
+		return false;
+	}
+
+	if (tag == RECORD_DELTA_FRAME)
+	{
+		uint8_t mask[4];
+
+		if (fread(mask, 1, sizeof(mask), file) != sizeof(mask))
+		{
+			return false;
+		}
+
+		uint32_t changed_rows = mask[0] | (mask[1] << 8u) | (mask[2] << 16u) | (uint32_t(mask[3]) << 24u);
+
+		//Expand the run length encoded delta
+		uint8_t delta[VIDEO_PACKED_SIZE];
+		unsigned int delta_size = 0;
+
+		for (unsigned int row = 0; row < VIDEO_HEIGHT; ++row)
+		{
+			if (changed_rows & (1u << row))
+			{
+				delta_size += VIDEO_ROW_BYTES;
+			}
+		}
+
+		unsigned int i = 0;
+
+		while (i < delta_size)
+		{
+			int token = fgetc(file);
+
+			if (token == EOF)
+			{
+				return false;
+			}
+
+			unsigned int count = (token & 0x7Fu) + 1;
+
+			if (i + count > delta_size)
+			{
+				return false;
+			}
+
+			if (token & 0x80u)
+			{
+				memset(&delta[i], 0, count);
+			}
+			else if (fread(&delta[i], 1, count, file) != count)
+			{
+				return false;
+			}
+
+			i += count;
+		}
+
+		//Apply the delta to the changed rows
+		unsigned int offset = 0;
+
+		for (unsigned int row = 0; row < VIDEO_HEIGHT; ++row)
+		{
+			if (!(changed_rows & (1u << row)))
+			{
+				continue;
+			}
+
+			for (unsigned int b = 0; b < VIDEO_ROW_BYTES; ++b)
+			{
+				current[row * VIDEO_ROW_BYTES + b] ^= delta[offset++];
+			}
+		}
+	}
+	else if (tag != RECORD_SAME_FRAME)
+	{
+		return false;
+	}
+
+	memcpy(packed, current, VIDEO_PACKED_SIZE);
+
+	return true;
+}
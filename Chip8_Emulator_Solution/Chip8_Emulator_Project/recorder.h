@@ -0,0 +1,90 @@
+#pragma once
+#include "chip8.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+- A recording is a header followed by one record per emulated frame
+- Header: "C8RV", version, width, height (7 bytes)
+- Frame record:
+	0x00 -> display identical to the previous frame
+	0x01 -> 4 byte mask of changed rows (bit n = row n), followed by the XOR of every
+	        changed row against the previous frame, run length encoded:
+	        0x80 | (n - 1) -> n zero bytes
+	        n - 1, bytes   -> n literal bytes
+- The first frame is XORed against an empty display
+*/
+
+const unsigned int RECORDING_VERSION = 1;
+const uint8_t RECORD_SAME_FRAME = 0x00;
+const uint8_t RECORD_DELTA_FRAME = 0x01;
+//Frames queued for the writer thread (about 4 seconds), a fixed ring so capturing never allocates
+const unsigned int RECORDER_QUEUE_FRAMES = 256;
+//Longest Capture waits for room in a full queue before it counts the writer as stalled
+const std::chrono::milliseconds RECORDER_STALL_TIMEOUT(250);
+
+class Recorder
+{
+public:
+	Recorder();
+	~Recorder();
+	//False if the file can't be created or a recording is already open
+	bool Open(char const* file_name);
+	//Called from the emulation thread once per frame, only packs the display and queues it
+	//With the queue full (emulation outrunning the encoder, e.g. in warp mode) it waits for the writer. Only when
+	//the writer frees nothing for RECORDER_STALL_TIMEOUT (stalled on the disk) is the frame dropped: the newest
+	//queued frame is written once more in its place, so the recording keeps its length. Until the writer
+	//frees a slot again, further frames are dropped without waiting
+	void Capture(Chip8 const& chip8);
+	//Flushes every queued frame and closes the file
+	void Close();
+	//Frames dropped because the queue was full
+	uint64_t Dropped();
+
+private:
+	struct QueuedFrame
+	{
+		uint8_t packed[VIDEO_PACKED_SIZE];
+		//Frames dropped after this one
+		uint32_t repeats;
+	};
+
+	void WriterLoop();
+	void Encode(uint8_t const* frame);
+
+	FILE* file{};
+	std::thread writer;
+	std::mutex queue_mutex;
+	std::condition_variable queue_ready;
+	std::condition_variable queue_space;
+	//Sized once by Open
+	std::vector<QueuedFrame> ring;
+	size_t ring_head{};
+	size_t ring_count{};
+	uint64_t dropped{};
+	//A wait for room timed out, set until the writer takes the next frame
+	bool stalled{};
+	bool closing{};
+
+	//Only touched by the writer thread
+	uint8_t previous[VIDEO_PACKED_SIZE]{};
+	std::vector<uint8_t> encoded;
+};
+
+class RecordingReader
+{
+public:
+	~RecordingReader();
+	bool Open(char const* file_name);
+	//Decodes the next frame into packed (VIDEO_PACKED_SIZE bytes), false at end of stream
+	bool NextFrame(uint8_t* packed);
+
+private:
+	FILE* file{};
+	uint8_t current[VIDEO_PACKED_SIZE]{};
+};
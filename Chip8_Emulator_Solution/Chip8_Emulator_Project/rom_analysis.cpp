@@ -0,0 +1,271 @@
+#include "rom_analysis.h"
+#include <ostream>
+#include <sstream>
+#include <vector>
+
+//What is known about I when an instruction starts
+enum IndexKind : uint8_t
+{
+	INDEX_UNREACHED,
+	INDEX_KNOWN,
+	INDEX_UNKNOWN
+};
+
+struct IndexState
+{
+	IndexKind kind;
+	uint16_t value;
+};
+
+static const IndexState index_unknown{ INDEX_UNKNOWN, 0 };
+
+
+//Every address is revisited at most twice (unreached -> known -> unknown), so the worklist always ends
+static void Merge(std::vector<IndexState>& states, std::vector<uint16_t>& worklist, uint16_t address, IndexState incoming)
+{
+	address &= (MEMORY_SIZE - 1);
+	IndexState& state = states[address];
+
+	if (state.kind == INDEX_UNREACHED)
+	{
+		state = incoming;
+	}
+	else if (state.kind == INDEX_KNOWN && (incoming.kind != INDEX_KNOWN || incoming.value != state.value))
+	{
+		state = index_unknown;
+	}
+	else
+	{
+		return;
+	}
+
+	worklist.push_back(address);
+}
+
+//Walks the code reachable without entering a call (a call is followed by the instruction after it, not its target),
+//the stack is empty there. Returns whether a 00EE is among it, and the first one found
+static bool FindStackUnderflow(Chip8 const& fresh, uint16_t& first)
+{
+	std::bitset<MEMORY_SIZE> visited;
+	std::vector<uint16_t> worklist(1, ROM_START_ADDRESS);
+	visited[ROM_START_ADDRESS] = true;
+
+	auto visit = [&](uint16_t address)
+	{
+		address &= (MEMORY_SIZE - 1);
+
+		if (!visited[address])
+		{
+			visited[address] = true;
+			worklist.push_back(address);
+		}
+	};
+
+	while (!worklist.empty())
+	{
+		uint16_t address = worklist.back();
+		worklist.pop_back();
+
+		uint16_t opcode = (fresh.ReadMemory(address) << 8u) | fresh.ReadMemory(address + 1);
+		uint16_t next = address + 2;
+
+		switch (DecodeInstruction(opcode))
+		{
+		case INSTRUCTION_00EE:
+			first = address;
+			return true;
+
+		case INSTRUCTION_1nnn:
+			visit(opcode & 0x0FFFu);
+			break;
+
+		//Bnnn already keeps the ROM off the pre-decoded engine
+		case INSTRUCTION_Bnnn:
+			break;
+
+		case INSTRUCTION_3xkk:
+		case INSTRUCTION_4xkk:
+		case INSTRUCTION_5xy0:
+		case INSTRUCTION_9xy0:
+		case INSTRUCTION_Ex9E:
+		case INSTRUCTION_ExA1:
+			visit(next);
+			visit(next + 2);
+			break;
+
+		default:
+			visit(next);
+			break;
+		}
+	}
+
+	return false;
+}
+
+static std::string Describe(char const* what, uint16_t address)
+{
+	std::ostringstream out;
+	out << what << " at 0x" << std::hex << address;
+	return out.str();
+}
+
+void AnalyzeRom(Chip8 const& fresh, RomAnalysis& analysis)
+{
+	analysis = RomAnalysis();
+
+	std::vector<IndexState> states(MEMORY_SIZE, IndexState{ INDEX_UNREACHED, 0 });
+	std::vector<uint16_t> worklist;
+
+	uint16_t firstIndirect = 0;
+	uint16_t firstUnknownWrite = 0;
+
+	//A fresh machine starts with I = 0
+	Merge(states, worklist, ROM_START_ADDRESS, IndexState{ INDEX_KNOWN, fresh.IndexRegister() });
+
+	while (!worklist.empty())
+	{
+		uint16_t address = worklist.back();
+		worklist.pop_back();
+
+		IndexState index = states[address];
+		uint16_t opcode = (fresh.ReadMemory(address) << 8u) | fresh.ReadMemory(address + 1);
+		uint16_t next = address + 2;
+
+		analysis.code[address] = true;
+		analysis.code[(address + 1) & (MEMORY_SIZE - 1)] = true;
+
+		switch (DecodeInstruction(opcode))
+		{
+		case INSTRUCTION_1nnn:
+			Merge(states, worklist, opcode & 0x0FFFu, index);
+			break;
+
+		case INSTRUCTION_2nnn:
+			Merge(states, worklist, opcode & 0x0FFFu, index);
+			//The subroutine may change I before it returns
+			Merge(states, worklist, next, index_unknown);
+			break;
+
+		case INSTRUCTION_00EE:
+			//Returns continue after their call, which the call already added
+			break;
+
+		case INSTRUCTION_Bnnn:
+			if (!analysis.indirect_jumps)
+			{
+				firstIndirect = address;
+			}
+
+			analysis.indirect_jumps = true;
+			break;
+
+		case INSTRUCTION_3xkk:
+		case INSTRUCTION_4xkk:
+		case INSTRUCTION_5xy0:
+		case INSTRUCTION_9xy0:
+		case INSTRUCTION_Ex9E:
+		case INSTRUCTION_ExA1:
+			Merge(states, worklist, next, index);
+			Merge(states, worklist, next + 2, index);
+			break;
+
+		case INSTRUCTION_Annn:
+			Merge(states, worklist, next, IndexState{ INDEX_KNOWN, static_cast<uint16_t>(opcode & 0x0FFFu) });
+			break;
+
+		case INSTRUCTION_Fx1E:
+		case INSTRUCTION_Fx29:
+			Merge(states, worklist, next, index_unknown);
+			break;
+
+		case INSTRUCTION_Fx33:
+		case INSTRUCTION_Fx55:
+		{
+			unsigned int count = DecodeInstruction(opcode) == INSTRUCTION_Fx33 ? 3 : ((opcode & 0x0F00u) >> 8u) + 1;
+
+			if (index.kind == INDEX_KNOWN)
+			{
+				for (unsigned int i = 0; i < count; ++i)
+				{
+					analysis.written[(index.value + i) & (MEMORY_SIZE - 1)] = true;
+				}
+			}
+			else
+			{
+				if (!analysis.unknown_writes)
+				{
+					firstUnknownWrite = address;
+				}
+
+				analysis.unknown_writes = true;
+			}
+
+			Merge(states, worklist, next, index);
+		} break;
+
+		case INSTRUCTION_Dxyn:
+			analysis.computed_draws |= index.kind != INDEX_KNOWN;
+			Merge(states, worklist, next, index);
+			break;
+
+		default:
+			Merge(states, worklist, next, index);
+			break;
+		}
+	}
+
+	for (IndexState const& state : states)
+	{
+		analysis.instructions += state.kind != INDEX_UNREACHED;
+	}
+
+	std::bitset<MEMORY_SIZE> overwritten = analysis.code & analysis.written;
+	analysis.self_modifying = overwritten.any();
+
+	uint16_t firstUnderflow = 0;
+	analysis.stack_underflow = FindStackUnderflow(fresh, firstUnderflow);
+
+	//StepCached is correct for any ROM (written pages are decoded from memory again), StepPredecoded drops that
+	//check and needs the proof that no reachable instruction is written. Code that is rewritten would keep
+	//missing the pre-decoded instructions, so those ROMs stay on the interpreter
+	if (analysis.self_modifying)
+	{
+		uint16_t first = 0;
+
+		while (!overwritten[first])
+		{
+			++first;
+		}
+
+		analysis.engine = ENGINE_INTERPRETER;
+		analysis.reason = Describe("rewrites its own code", first);
+	}
+	else if (analysis.indirect_jumps)
+	{
+		analysis.engine = ENGINE_CACHED;
+		analysis.reason = Describe("Bnnn jumps to code the analysis cannot see", firstIndirect);
+	}
+	else if (analysis.stack_underflow)
+	{
+		analysis.engine = ENGINE_CACHED;
+		analysis.reason = Describe("00EE returns with an empty stack", firstUnderflow);
+	}
+	else if (analysis.unknown_writes)
+	{
+		analysis.engine = ENGINE_CACHED;
+		analysis.reason = Describe("writes memory through a computed I", firstUnknownWrite);
+	}
+	else
+	{
+		analysis.engine = ENGINE_PREDECODED;
+		analysis.reason = "no reachable instruction is ever written";
+	}
+}
+
+void PrintRomAnalysis(RomAnalysis const& analysis, std::ostream& out)
+{
+	out << "ROM analysis: " << analysis.instructions << " reachable instructions, "
+		<< analysis.written.count() << " bytes written at known addresses"
+		<< (analysis.computed_draws ? ", draws from computed I" : "") << "\n"
+		<< "Engine: " << EngineName(analysis.engine) << " (" << analysis.reason << ")\n";
+}
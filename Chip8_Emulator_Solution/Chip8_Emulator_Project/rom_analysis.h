@@ -0,0 +1,43 @@
+#pragma once
+#include "chip8.h"
+#include <bitset>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+
+/*
+- Static analysis of a freshly loaded ROM, run once per distinct ROM by the ROM cache
+- Recursive disassembly from 0x200: follows jumps, calls (and the instruction after them), both sides of skips
+- I is tracked per instruction as a known constant (set by Annn) or unknown (Fx1E, Fx29, after a call),
+  so Fx33/Fx55 with a known I give exact written ranges
+- Bnnn jumps to an address only known at run time, so the code it reaches is never seen by the analysis
+- 00EE returns to the call that led to it; one reachable without any call (from 0x200 through jumps, skips and the
+  instructions after calls) returns with an empty stack, to whatever the stack held (0x000 on a fresh machine),
+  code the analysis cannot see either
+*/
+
+struct RomAnalysis
+{
+	//Both bytes of every reachable instruction
+	std::bitset<MEMORY_SIZE> code;
+	//Bytes written by Fx33/Fx55 with a known I
+	std::bitset<MEMORY_SIZE> written;
+	unsigned int instructions{};
+	//A known write lands on reachable code
+	bool self_modifying{};
+	//Fx33/Fx55 with an unknown I, could write anywhere
+	bool unknown_writes{};
+	//Bnnn is reachable, some code may not have been found
+	bool indirect_jumps{};
+	//00EE is reachable with an empty stack, it returns to an address the analysis does not know
+	bool stack_underflow{};
+	//Dxyn with an unknown I
+	bool computed_draws{};
+	//Fastest engine that is correct for the ROM, and why
+	Engine engine{ ENGINE_INTERPRETER };
+	std::string reason;
+};
+
+//fresh: a machine right after loading the ROM
+void AnalyzeRom(Chip8 const& fresh, RomAnalysis& analysis);
+void PrintRomAnalysis(RomAnalysis const& analysis, std::ostream& out);
@@ -0,0 +1,303 @@
+#include "rom_cache.h"
+#include <cstring>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+struct CacheEntry
+{
+	std::unique_ptr<RomImage> image;
+	unsigned int references;
+};
+
+//cache_mutex guards the cache, the reference counts and the path index
+static std::mutex cache_mutex;
+static const uint8_t empty_rom[1] = { 0 };
+static std::unordered_multimap<uint64_t, CacheEntry> cache;
+
+static void ForgetPaths(RomImage const* image);
+
+
+//64 bit multiply-xor hash over 8 byte words, only used to find candidates (contents are compared on a hit)
+uint64_t HashRom(uint8_t const* data, size_t size)
+{
+	const uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+	uint64_t hash = size * multiplier;
+	size_t i = 0;
+
+	for (; i + 8 <= size; i += 8)
+	{
+		uint64_t word;
+		memcpy(&word, &data[i], 8);
+
+		hash = (hash ^ word) * multiplier;
+		hash ^= hash >> 29u;
+	}
+
+	uint64_t tail = 0;
+	memcpy(&tail, &data[i], size - i);
+
+	hash = (hash ^ tail) * multiplier;
+	hash ^= hash >> 32u;
+
+	return hash;
+}
+
+//Entry holding the same bytes, nullptr if there is none. Called with cache_mutex held
+static CacheEntry* Find(uint64_t hash, uint8_t const* data, size_t size)
+{
+	auto range = cache.equal_range(hash);
+
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		RomImage const& image = *it->second.image;
+
+		if (image.bytes.size() == size && (size == 0 || memcmp(image.bytes.data(), data, size) == 0))
+		{
+			return &it->second;
+		}
+	}
+
+	return nullptr;
+}
+
+RomImage const* CacheRomImage(uint8_t const* data, size_t size)
+{
+	if (size > ROM_MAX_SIZE)
+	{
+		return nullptr;
+	}
+
+	uint64_t hash = HashRom(data, size);
+
+	{
+		std::lock_guard<std::mutex> lock(cache_mutex);
+
+		if (CacheEntry* entry = Find(hash, data, size))
+		{
+			++entry->references;
+			return entry->image.get();
+		}
+	}
+
+	std::unique_ptr<RomImage> image(new RomImage);
+	image->hash = hash;
+	image->bytes.assign(data, data + size);
+	image->memory_hash = Chip8::HashRomMemory(data, size);
+
+	//Decode with the same memory layout (fonts, zeroes) a fresh machine has after loading the ROM
+	Chip8 fresh;
+	fresh.load_ROM(data, size);
+	fresh.DecodeMemory(image->decoded);
+	AnalyzeRom(fresh, image->analysis);
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+
+	//Another thread may have added the same ROM meanwhile, its image wins
+	if (CacheEntry* entry = Find(hash, data, size))
+	{
+		++entry->references;
+		return entry->image.get();
+	}
+
+	RomImage const* result = image.get();
+	cache.emplace(hash, CacheEntry{ std::move(image), 1 });
+
+	return result;
+}
+
+void ReleaseRomImage(RomImage const* image)
+{
+	if (!image)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(cache_mutex);
+	auto range = cache.equal_range(image->hash);
+
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		if (it->second.image.get() == image)
+		{
+			if (--it->second.references == 0)
+			{
+				ForgetPaths(image);
+				cache.erase(it);
+			}
+
+			return;
+		}
+	}
+}
+
+#ifdef _WIN32
+
+static void ForgetPaths(RomImage const*)
+{
+}
+
+RomImage const* LoadRomImage(char const* file_name)
+{
+	HANDLE file = CreateFileA(file_name, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return nullptr;
+	}
+
+	LARGE_INTEGER size;
+
+	if (!GetFileSizeEx(file, &size) || size.QuadPart > ROM_MAX_SIZE)
+	{
+		CloseHandle(file);
+		return nullptr;
+	}
+
+	if (size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return CacheRomImage(empty_rom, 0);
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	void const* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+
+	RomImage const* image = nullptr;
+
+	if (view)
+	{
+		image = CacheRomImage(static_cast<uint8_t const*>(view), static_cast<size_t>(size.QuadPart));
+		UnmapViewOfFile(view);
+	}
+
+	if (mapping)
+	{
+		CloseHandle(mapping);
+	}
+
+	CloseHandle(file);
+
+	return image;
+}
+
+#else
+
+//Images by path, so loading an unchanged file again is a single stat
+struct PathEntry
+{
+	dev_t device;
+	ino_t inode;
+	off_t size;
+	struct timespec modified;
+	RomImage const* image;
+};
+
+static std::unordered_map<std::string, PathEntry> paths;
+
+//The index holds no reference, entries of a freed image go with it
+static void ForgetPaths(RomImage const* image)
+{
+	for (auto it = paths.begin(); it != paths.end(); )
+	{
+		it = it->second.image == image ? paths.erase(it) : std::next(it);
+	}
+}
+
+//A reference to an image found through the path index, called with cache_mutex held
+static RomImage const* Reference(RomImage const* image)
+{
+	auto range = cache.equal_range(image->hash);
+
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		if (it->second.image.get() == image)
+		{
+			++it->second.references;
+			break;
+		}
+	}
+
+	return image;
+}
+
+static bool SameFile(PathEntry const& entry, struct stat const& info)
+{
+	return entry.device == info.st_dev
+		&& entry.inode == info.st_ino
+		&& entry.size == info.st_size
+		&& entry.modified.tv_sec == info.st_mtim.tv_sec
+		&& entry.modified.tv_nsec == info.st_mtim.tv_nsec;
+}
+
+RomImage const* LoadRomImage(char const* file_name)
+{
+	struct stat info;
+
+	if (stat(file_name, &info) == 0)
+	{
+		std::lock_guard<std::mutex> lock(cache_mutex);
+		auto it = paths.find(file_name);
+
+		if (it != paths.end() && SameFile(it->second, info))
+		{
+			return Reference(it->second.image);
+		}
+	}
+
+	int file = open(file_name, O_RDONLY);
+
+	if (file < 0)
+	{
+		return nullptr;
+	}
+
+	if (fstat(file, &info) != 0 || info.st_size > static_cast<off_t>(ROM_MAX_SIZE))
+	{
+		close(file);
+		return nullptr;
+	}
+
+	size_t size = static_cast<size_t>(info.st_size);
+
+	//mmap refuses empty files
+	if (size == 0)
+	{
+		close(file);
+		return CacheRomImage(empty_rom, 0);
+	}
+
+	void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0);
+	close(file);
+
+	if (view == MAP_FAILED)
+	{
+		return nullptr;
+	}
+
+	RomImage const* image = CacheRomImage(static_cast<uint8_t const*>(view), size);
+	munmap(view, size);
+
+	if (image)
+	{
+		std::lock_guard<std::mutex> lock(cache_mutex);
+		paths[file_name] = PathEntry{ info.st_dev, info.st_ino, info.st_size, info.st_mtim, image };
+	}
+
+	return image;
+}
+
+#endif
@@ -0,0 +1,38 @@
+#pragma once
+#include "chip8.h"
+#include "rom_analysis.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/*
+- Process wide cache of ROMs keyed by a hash of their contents
+- Files are memory mapped, checked to fit in 0x200 - 0xFFF and copied once into the cache
+- An image also holds what is derived from the ROM (pre-decoded instructions, analysis), computed once per distinct ROM,
+  outside the cache lock so other loads are not held up
+- Every image returned is a reference: it stays until each LoadRomImage/CacheRomImage of it is matched by a
+  ReleaseRomImage. Machines keep a plain pointer, so an image is released only once no machine uses it
+  (hosts that load a ROM once for the whole process never release it)
+*/
+
+struct RomImage
+{
+	uint64_t hash;
+	std::vector<uint8_t> bytes;
+	//Chip8::HashRomMemory of the bytes, so loading the image does not rehash memory
+	uint64_t memory_hash;
+	//DecodeInstruction of the word at every address of a freshly loaded machine
+	uint8_t decoded[MEMORY_SIZE];
+	//Reachable code, writes and the engine it can run on
+	RomAnalysis analysis;
+};
+
+//Hash used as the cache key
+uint64_t HashRom(uint8_t const* data, size_t size);
+
+//nullptr if the file cannot be read or is larger than ROM_MAX_SIZE
+RomImage const* LoadRomImage(char const* file_name);
+//Same as LoadRomImage for a ROM that is already in memory
+RomImage const* CacheRomImage(uint8_t const* data, size_t size);
+//Drops one reference, the image is freed with the last one
+void ReleaseRomImage(RomImage const* image);
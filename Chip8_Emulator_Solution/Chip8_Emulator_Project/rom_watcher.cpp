@@ -0,0 +1,188 @@
+#include "rom_watcher.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+//Longest time between two looks at the file, inotify wakes the watcher earlier
+const std::chrono::milliseconds poll_interval(250);
+//Writers often take a few steps (truncate, write, close), wait for them to finish before loading
+const std::chrono::milliseconds settle_time(20);
+
+
+RomWatcher::~RomWatcher()
+{
+	Stop();
+}
+
+void RomWatcher::Start(char const* file_name, RomImage const* current)
+{
+	path = file_name;
+	loaded = current ? current->bytes : std::vector<uint8_t>();
+	stopping = false;
+
+	size_t slash = path.find_last_of("/\\");
+	std::string directory = slash == std::string::npos ? "." : path.substr(0, slash + 1);
+	name = slash == std::string::npos ? path : path.substr(slash + 1);
+
+#ifdef __linux__
+	notify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+	if (notify_fd >= 0 && inotify_add_watch(notify_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+	{
+		close(notify_fd);
+		notify_fd = -1;
+	}
+#else
+	(void)directory;
+#endif
+
+	struct stat info;
+
+	if (stat(path.c_str(), &info) == 0)
+	{
+		polled_size = static_cast<long long>(info.st_size);
+		polled_time = static_cast<long long>(info.st_mtime);
+	}
+
+	watcher = std::thread(&RomWatcher::WatchLoop, this);
+}
+
+void RomWatcher::Stop()
+{
+	if (!watcher.joinable())
+	{
+		return;
+	}
+
+	stopping = true;
+	watcher.join();
+	ReleaseRomImage(changed.exchange(nullptr));
+
+#ifdef __linux__
+	if (notify_fd >= 0)
+	{
+		close(notify_fd);
+		notify_fd = -1;
+	}
+#endif
+}
+
+void RomWatcher::WatchLoop()
+{
+	while (!stopping)
+	{
+		if (!WaitForChange() || stopping)
+		{
+			continue;
+		}
+
+		//Missing or too large files (being replaced) and unchanged ones are skipped until the next change
+		if (RomImage const* image = ReadFile())
+		{
+			loaded = image->bytes;
+			ReleaseRomImage(changed.exchange(image, std::memory_order_acq_rel));
+		}
+	}
+}
+
+//One byte more than fits, so a file that grew too large is told apart from one that just fits
+//nullptr as well when the bytes are those of the version loaded last
+RomImage const* RomWatcher::ReadFile()
+{
+	FILE* file = fopen(path.c_str(), "rb");
+
+	if (!file)
+	{
+		return nullptr;
+	}
+
+	uint8_t buffer[ROM_MAX_SIZE + 1];
+	size_t size = fread(buffer, 1, sizeof(buffer), file);
+	bool failed = ferror(file) != 0;
+	fclose(file);
+
+	if (failed || size > ROM_MAX_SIZE || (size == loaded.size() && std::equal(loaded.begin(), loaded.end(), buffer)))
+	{
+		return nullptr;
+	}
+
+	return CacheRomImage(buffer, size);
+}
+
+bool RomWatcher::WaitForChange()
+{
+#ifdef __linux__
+	if (notify_fd >= 0)
+	{
+		pollfd fd{ notify_fd, POLLIN, 0 };
+
+		if (poll(&fd, 1, static_cast<int>(poll_interval.count())) <= 0)
+		{
+			return false;
+		}
+
+		bool ours = false;
+		bool pending;
+
+		//Drain every queued event, only events for the ROM's name matter. A writer that closes and reopens
+		//the file right away gets settle_time to finish before the version is read
+		do
+		{
+			alignas(inotify_event) char buffer[4096];
+			ssize_t size;
+			bool found = false;
+
+			while ((size = read(notify_fd, buffer, sizeof(buffer))) > 0)
+			{
+				for (char* event = buffer; event < buffer + size; )
+				{
+					inotify_event const* info = reinterpret_cast<inotify_event const*>(event);
+					found |= info->len > 0 && name == info->name;
+					event += sizeof(inotify_event) + info->len;
+				}
+			}
+
+			if (found)
+			{
+				ours = true;
+				std::this_thread::sleep_for(settle_time);
+			}
+
+			pending = found && poll(&fd, 1, 0) > 0;
+		} while (pending);
+
+		return ours;
+	}
+#endif
+
+	std::this_thread::sleep_for(poll_interval);
+
+	//Only a size or time that stays the same over settle_time counts, a write in progress is read next time
+	struct stat before;
+	struct stat after;
+
+	if (stat(path.c_str(), &before) != 0
+		|| (static_cast<long long>(before.st_size) == polled_size && static_cast<long long>(before.st_mtime) == polled_time))
+	{
+		return false;
+	}
+
+	std::this_thread::sleep_for(settle_time);
+
+	if (stat(path.c_str(), &after) != 0 || after.st_size != before.st_size || after.st_mtime != before.st_mtime)
+	{
+		return false;
+	}
+
+	polled_size = static_cast<long long>(after.st_size);
+	polled_time = static_cast<long long>(after.st_mtime);
+
+	return true;
+}
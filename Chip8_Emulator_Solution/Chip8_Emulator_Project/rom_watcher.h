@@ -0,0 +1,49 @@
+#pragma once
+#include "rom_cache.h"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+- Watches a ROM file and loads every new version through the ROM cache on its own thread,
+  so the emulation thread only picks up a ready image between frames
+- Linux: inotify on the directory, a new version is loaded after the file is closed for writing or renamed
+  over the old one (editors and assemblers often write a new file and rename it)
+- Elsewhere, or when inotify is not available: the file's size and modification time are polled, a new version
+  is loaded once they stop changing
+- The file is read, not memory mapped: a writer truncating it in place cannot fault the watcher
+- A version is compared with the last one by its bytes, only a new one takes a ROM cache reference, which goes to
+  whoever takes the image (a version replaced before it was taken is released)
+*/
+
+class RomWatcher
+{
+public:
+	~RomWatcher();
+	//Starts watching the file, current is the image already loaded from it
+	void Start(char const* file_name, RomImage const* current);
+	void Stop();
+	//Image of a new version of the file since the last call, nullptr when nothing changed
+	//The caller owns the reference (ReleaseRomImage)
+	RomImage const* TakeChanged() { return changed.exchange(nullptr, std::memory_order_acquire); }
+
+private:
+	void WatchLoop();
+	//Sleeps until the file was written or replaced (true) or about poll_interval passed (false)
+	bool WaitForChange();
+	//Image of the file's current contents, nullptr if it cannot be read or does not fit
+	RomImage const* ReadFile();
+
+	std::string path;
+	std::string name;
+	//Bytes of the version loaded last
+	std::vector<uint8_t> loaded;
+	std::thread watcher;
+	std::atomic<RomImage const*> changed{};
+	std::atomic<bool> stopping{};
+	int notify_fd{ -1 };
+	//Size and modification time seen by the last poll, without inotify
+	long long polled_size{ -1 };
+	long long polled_time{ -1 };
+};
@@ -0,0 +1,336 @@
+#include "scaler.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#if defined(__AVX2__)
+#define SCALER_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SCALER_SSE2
+#include <emmintrin.h>
+#endif
+
+//Largest PNG stored deflate block
+const unsigned int png_block_size = 65535;
+
+
+//Colour as it is laid out in memory, R, G, B, A bytes whatever the byte order of the host
+static uint32_t MemoryOrder(uint32_t colour)
+{
+	uint8_t bytes[4] = { uint8_t(colour >> 24u), uint8_t(colour >> 16u), uint8_t(colour >> 8u), uint8_t(colour) };
+	uint32_t word;
+	memcpy(&word, bytes, sizeof(word));
+
+	return word;
+}
+
+//Half brightness, alpha kept
+static uint32_t Dim(uint32_t colour)
+{
+	return ((colour >> 1u) & 0x7F7F7F00u) | (colour & 0xFFu);
+}
+
+//count pixels of one colour (in memory order)
+static void Fill(uint8_t* out, uint32_t word, unsigned int count)
+{
+	unsigned int i = 0;
+
+#if defined(SCALER_AVX2)
+	__m256i wide = _mm256_set1_epi32(static_cast<int>(word));
+
+	for (; i + 8 <= count; i += 8)
+	{
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i * 4), wide);
+	}
+#endif
+#if defined(SCALER_AVX2) || defined(SCALER_SSE2)
+	__m128i narrow = _mm_set1_epi32(static_cast<int>(word));
+
+	for (; i + 4 <= count; i += 4)
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i * 4), narrow);
+	}
+#endif
+
+	for (; i < count; ++i)
+	{
+		memcpy(out + i * 4, &word, sizeof(word));
+	}
+}
+
+//Row replication, the bulk of the work
+static void CopyRow(uint8_t* out, uint8_t const* row, size_t bytes)
+{
+	size_t i = 0;
+
+#if defined(SCALER_AVX2)
+	for (; i + 32 <= bytes; i += 32)
+	{
+		_mm256_storeu_si256(reinterpret_cast<__m256i*>(out + i), _mm256_loadu_si256(reinterpret_cast<__m256i const*>(row + i)));
+	}
+#elif defined(SCALER_SSE2)
+	for (; i + 16 <= bytes; i += 16)
+	{
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(out + i), _mm_loadu_si128(reinterpret_cast<__m128i const*>(row + i)));
+	}
+#endif
+
+	memcpy(out + i, row + i, bytes - i);
+}
+
+//One display row into one output row: every pixel repeated scale times, the last one in grid when there is a grid
+static void ExpandRow(uint8_t const* packedRow, unsigned int scale, uint32_t on, uint32_t off, bool hasGrid, uint32_t grid,
+	uint8_t* out)
+{
+	unsigned int width = hasGrid ? scale - 1 : scale;
+
+	for (unsigned int x = 0; x < VIDEO_WIDTH; ++x)
+	{
+		uint8_t* cell = out + x * scale * 4;
+		Fill(cell, (packedRow[x / 8] & (0x80u >> (x % 8))) ? on : off, width);
+
+		if (hasGrid)
+		{
+			memcpy(cell + width * 4, &grid, sizeof(grid));
+		}
+	}
+}
+
+void ScaleDisplay(uint8_t const* packed, ScaleOptions const& options, uint8_t* rgba, size_t pitch)
+{
+	unsigned int scale = options.scale;
+	size_t rowBytes = static_cast<size_t>(ScaledWidth(options)) * 4;
+
+	uint32_t on = MemoryOrder(options.on);
+	uint32_t off = MemoryOrder(options.off);
+	uint32_t grid = MemoryOrder(options.grid);
+	uint32_t dimOn = MemoryOrder(Dim(options.on));
+	uint32_t dimOff = MemoryOrder(Dim(options.off));
+
+	//A grid needs cells of at least 2x2, a scanline a second row
+	ScaleFilter filter = scale < 2 ? SCALE_NEAREST : options.filter;
+
+	for (unsigned int y = 0; y < VIDEO_HEIGHT; ++y)
+	{
+		uint8_t const* packedRow = packed + y * VIDEO_ROW_BYTES;
+		uint8_t* cell = rgba + static_cast<size_t>(y) * scale * pitch;
+
+		ExpandRow(packedRow, scale, on, off, filter == SCALE_GRID, grid, cell);
+
+		switch (filter)
+		{
+		case SCALE_SCANLINES:
+			ExpandRow(packedRow, scale, dimOn, dimOff, false, 0, cell + pitch);
+
+			for (unsigned int row = 2; row < scale; ++row)
+			{
+				CopyRow(cell + row * pitch, cell + (row & 1u) * pitch, rowBytes);
+			}
+			break;
+
+		case SCALE_GRID:
+			for (unsigned int row = 1; row + 1 < scale; ++row)
+			{
+				CopyRow(cell + row * pitch, cell, rowBytes);
+			}
+
+			Fill(cell + (scale - 1) * pitch, grid, ScaledWidth(options));
+			break;
+
+		default:
+			for (unsigned int row = 1; row < scale; ++row)
+			{
+				CopyRow(cell + row * pitch, cell, rowBytes);
+			}
+			break;
+		}
+	}
+}
+
+bool ParseScaleFilter(char const* name, ScaleFilter& filter)
+{
+	if (std::strcmp(name, "nearest") == 0)
+	{
+		filter = SCALE_NEAREST;
+	}
+	else if (std::strcmp(name, "scanlines") == 0)
+	{
+		filter = SCALE_SCANLINES;
+	}
+	else if (std::strcmp(name, "grid") == 0)
+	{
+		filter = SCALE_GRID;
+	}
+	else
+	{
+		return false;
+	}
+
+	return true;
+}
+
+bool WritePpm(char const* file_name, uint8_t const* rgba, unsigned int width, unsigned int height, size_t pitch)
+{
+	FILE* file = fopen(file_name, "wb");
+
+	if (!file)
+	{
+		return false;
+	}
+
+	fprintf(file, "P6\n%u %u\n255\n", width, height);
+
+	std::vector<uint8_t> rgb(static_cast<size_t>(width) * 3);
+	bool ok = true;
+
+	for (unsigned int y = 0; y < height && ok; ++y)
+	{
+		uint8_t const* row = rgba + y * pitch;
+
+		for (unsigned int x = 0; x < width; ++x)
+		{
+			rgb[x * 3 + 0] = row[x * 4 + 0];
+			rgb[x * 3 + 1] = row[x * 4 + 1];
+			rgb[x * 3 + 2] = row[x * 4 + 2];
+		}
+
+		ok = fwrite(rgb.data(), 1, rgb.size(), file) == rgb.size();
+	}
+
+	return fclose(file) == 0 && ok;
+}
+
+struct CrcTable
+{
+	uint32_t entries[256];
+
+	CrcTable()
+	{
+		for (uint32_t n = 0; n < 256; ++n)
+		{
+			uint32_t c = n;
+
+			for (unsigned int bit = 0; bit < 8; ++bit)
+			{
+				c = (c & 1u) ? 0xEDB88320u ^ (c >> 1u) : c >> 1u;
+			}
+
+			entries[n] = c;
+		}
+	}
+};
+
+static uint32_t Crc32(uint8_t const* data, size_t size)
+{
+	static const CrcTable table;
+	uint32_t crc = 0xFFFFFFFFu;
+
+	for (size_t i = 0; i < size; ++i)
+	{
+		crc = table.entries[(crc ^ data[i]) & 0xFFu] ^ (crc >> 8u);
+	}
+
+	return ~crc;
+}
+
+//The sums cannot overflow for adler_run bytes, so the modulo is only taken once per run
+static uint32_t Adler32(uint8_t const* data, size_t size)
+{
+	const size_t adler_run = 5552;
+	uint32_t a = 1;
+	uint32_t b = 0;
+
+	while (size > 0)
+	{
+		size_t run = size < adler_run ? size : adler_run;
+
+		for (size_t i = 0; i < run; ++i)
+		{
+			a += data[i];
+			b += a;
+		}
+
+		a %= 65521u;
+		b %= 65521u;
+		data += run;
+		size -= run;
+	}
+
+	return (b << 16u) | a;
+}
+
+static void PutBigEndian(std::vector<uint8_t>& out, uint32_t value)
+{
+	out.push_back(uint8_t(value >> 24u));
+	out.push_back(uint8_t(value >> 16u));
+	out.push_back(uint8_t(value >> 8u));
+	out.push_back(uint8_t(value));
+}
+
+//Length, type, data, CRC of type and data
+static void PutChunk(std::vector<uint8_t>& out, char const* type, std::vector<uint8_t> const& data)
+{
+	PutBigEndian(out, static_cast<uint32_t>(data.size()));
+	size_t start = out.size();
+	out.insert(out.end(), type, type + 4);
+	out.insert(out.end(), data.begin(), data.end());
+	PutBigEndian(out, Crc32(&out[start], out.size() - start));
+}
+
+bool WritePng(char const* file_name, uint8_t const* rgba, unsigned int width, unsigned int height, size_t pitch)
+{
+	//Filter byte 0 (none) in front of every row
+	size_t rowBytes = static_cast<size_t>(width) * 4;
+	std::vector<uint8_t> raw;
+	raw.reserve((rowBytes + 1) * height);
+
+	for (unsigned int y = 0; y < height; ++y)
+	{
+		raw.push_back(0);
+		raw.insert(raw.end(), rgba + y * pitch, rgba + y * pitch + rowBytes);
+	}
+
+	//zlib stream of stored blocks: header, blocks (final flag, length, its complement, bytes), Adler-32
+	std::vector<uint8_t> zlib{ 0x78, 0x01 };
+	zlib.reserve(raw.size() + raw.size() / png_block_size * 5 + 16);
+	size_t offset = 0;
+
+	do
+	{
+		size_t size = raw.size() - offset < png_block_size ? raw.size() - offset : png_block_size;
+		bool last = offset + size == raw.size();
+
+		zlib.push_back(last ? 1 : 0);
+		zlib.push_back(uint8_t(size));
+		zlib.push_back(uint8_t(size >> 8u));
+		zlib.push_back(uint8_t(~size));
+		zlib.push_back(uint8_t(~size >> 8u));
+		zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + size);
+		offset += size;
+	} while (offset < raw.size());
+
+	PutBigEndian(zlib, Adler32(raw.data(), raw.size()));
+
+	std::vector<uint8_t> header;
+	PutBigEndian(header, width);
+	PutBigEndian(header, height);
+	//8 bits per channel, RGBA, deflate, adaptive filtering, not interlaced
+	header.insert(header.end(), { 8, 6, 0, 0, 0 });
+
+	std::vector<uint8_t> png{ 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	PutChunk(png, "IHDR", header);
+	PutChunk(png, "IDAT", zlib);
+	PutChunk(png, "IEND", std::vector<uint8_t>());
+
+	FILE* file = fopen(file_name, "wb");
+
+	if (!file)
+	{
+		return false;
+	}
+
+	bool ok = fwrite(png.data(), 1, png.size(), file) == png.size();
+
+	return fclose(file) == 0 && ok;
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include "chip8.h"
+#include <cstddef>
+#include <cstdint>
+
+/*
+- Software scaler for output without a renderer (screenshots, recordings, streams): the packed display
+  (Chip8::PackVideo, recordings) becomes an integer scaled RGBA image (R, G, B, A bytes per pixel)
+- Each display row is expanded once into the first output row of its cell, the other rows of the cell are
+  copies of it (or of a second, filtered row), so the cost is mostly the copies: 16/32 byte SSE2/AVX2 stores
+- Images are written into caller buffers, WritePpm/WritePng save them
+*/
+
+enum ScaleFilter
+{
+	SCALE_NEAREST,
+	//Every other row of a cell at half brightness
+	SCALE_SCANLINES,
+	//Last row and column of every cell in the grid colour
+	SCALE_GRID
+};
+
+struct ScaleOptions
+{
+	unsigned int scale{ 10 };
+	ScaleFilter filter{ SCALE_NEAREST };
+	//0xRRGGBBAA
+	uint32_t on{ 0xFFFFFFFF };
+	uint32_t off{ 0x000000FF };
+	uint32_t grid{ 0x202020FF };
+};
+
+inline unsigned int ScaledWidth(ScaleOptions const& options) { return VIDEO_WIDTH * options.scale; }
+inline unsigned int ScaledHeight(ScaleOptions const& options) { return VIDEO_HEIGHT * options.scale; }
+
+//Scale the packed display (VIDEO_PACKED_SIZE bytes) into rgba, ScaledWidth x ScaledHeight pixels, pitch bytes per row
+void ScaleDisplay(uint8_t const* packed, ScaleOptions const& options, uint8_t* rgba, size_t pitch);
+//Filter by name (nearest, scanlines, grid), false for an unknown name
+bool ParseScaleFilter(char const* name, ScaleFilter& filter);
+
+//Binary PPM (P6), alpha is dropped
+bool WritePpm(char const* file_name, uint8_t const* rgba, unsigned int width, unsigned int height, size_t pitch);
+//RGBA PNG with stored (uncompressed) deflate blocks, so no compression library is needed
+bool WritePng(char const* file_name, uint8_t const* rgba, unsigned int width, unsigned int height, size_t pitch);
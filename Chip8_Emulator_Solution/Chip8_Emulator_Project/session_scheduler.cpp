@@ -0,0 +1,258 @@
+#include "session_scheduler.h"
+#include <algorithm>
+
+//60Hz frame period of every session
+const std::chrono::nanoseconds session_frame_time(1000000000 / 60);
+//Longest an idle worker sleeps before it looks for frames to steal again
+const std::chrono::microseconds steal_poll(500);
+
+
+//std::push_heap/pop_heap build a max-heap, so later releases compare as smaller
+static bool LaterRelease(SessionScheduler::Clock::time_point a, SessionScheduler::Clock::time_point b)
+{
+	return a > b;
+}
+
+SessionScheduler::SessionScheduler(unsigned int threads)
+{
+	thread_count = threads ? threads : std::max(1u, std::thread::hardware_concurrency());
+	queues.reset(new RunQueue[thread_count]);
+}
+
+SessionScheduler::~SessionScheduler()
+{
+	Stop();
+}
+
+//Sessions added before the start would all be released at once, long overdue: their first frames are spread over one period from now instead
+void SessionScheduler::Start()
+{
+	stopping = false;
+
+	Clock::time_point now = Clock::now();
+	size_t queued = 0;
+
+	for (unsigned int worker = 0; worker < thread_count; ++worker)
+	{
+		queued += queues[worker].heap.size();
+	}
+
+	size_t position = 0;
+
+	for (unsigned int worker = 0; worker < thread_count; ++worker)
+	{
+		std::lock_guard<std::mutex> lock(queues[worker].mutex);
+
+		//Releases ascending along the array keep it a valid heap, earliest first
+		for (QueuedFrame& frame : queues[worker].heap)
+		{
+			frame.release = now + session_frame_time * position++ / queued;
+		}
+	}
+
+	for (unsigned int worker = 0; worker < thread_count; ++worker)
+	{
+		workers.emplace_back(&SessionScheduler::WorkerLoop, this, worker);
+	}
+}
+
+void SessionScheduler::Stop()
+{
+	stopping = true;
+
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+
+	workers.clear();
+}
+
+unsigned int SessionScheduler::AddSession(Chip8 const& machine, unsigned int cycles)
+{
+	std::unique_ptr<Session> session(new Session);
+	session->chip8 = machine;
+	session->cycles = cycles;
+	session->keys = machine.keypad;
+
+	Session* added = session.get();
+	unsigned int id;
+
+	{
+		std::lock_guard<std::mutex> lock(sessions_mutex);
+		id = static_cast<unsigned int>(sessions.size());
+		sessions.push_back(std::move(session));
+	}
+
+	Push(queues[id % thread_count], QueuedFrame{ Clock::now(), added });
+
+	return id;
+}
+
+SessionScheduler::Session& SessionScheduler::Find(unsigned int id)
+{
+	std::lock_guard<std::mutex> lock(sessions_mutex);
+	return *sessions.at(id);
+}
+
+void SessionScheduler::SetKeys(unsigned int id, uint16_t keys)
+{
+	Find(id).keys.store(keys, std::memory_order_relaxed);
+}
+
+void SessionScheduler::Snapshot(unsigned int id, Chip8& out)
+{
+	Session& session = Find(id);
+	std::lock_guard<std::mutex> lock(session.mutex);
+	out = session.chip8;
+}
+
+SessionStats SessionScheduler::GetSessionStats(unsigned int id)
+{
+	Session& session = Find(id);
+	return SessionStats{ session.frames.load(), session.missed.load(), session.skipped.load() };
+}
+
+unsigned int SessionScheduler::SessionCount()
+{
+	std::lock_guard<std::mutex> lock(sessions_mutex);
+	return static_cast<unsigned int>(sessions.size());
+}
+
+void SessionScheduler::Push(RunQueue& queue, QueuedFrame const& frame)
+{
+	std::lock_guard<std::mutex> lock(queue.mutex);
+	queue.heap.push_back(frame);
+	std::push_heap(queue.heap.begin(), queue.heap.end(), [](QueuedFrame const& a, QueuedFrame const& b)
+	{
+		return LaterRelease(a.release, b.release);
+	});
+}
+
+//The earliest deadline in the queue, if its period has started
+bool SessionScheduler::PopReleased(RunQueue& queue, Clock::time_point now, QueuedFrame& frame)
+{
+	if (queue.heap.empty() || queue.heap.front().release > now)
+	{
+		return false;
+	}
+
+	std::pop_heap(queue.heap.begin(), queue.heap.end(), [](QueuedFrame const& a, QueuedFrame const& b)
+	{
+		return LaterRelease(a.release, b.release);
+	});
+
+	frame = queue.heap.back();
+	queue.heap.pop_back();
+
+	return true;
+}
+
+//Takes the earliest frame of a victim released no later than before, victims are tried starting with first
+bool SessionScheduler::Steal(unsigned int first, unsigned int victims, Clock::time_point before, QueuedFrame& frame)
+{
+	for (unsigned int offset = 0; offset < victims; ++offset)
+	{
+		RunQueue& victim = queues[(first + offset) % thread_count];
+		std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+
+		if (lock.owns_lock() && PopReleased(victim, before, frame))
+		{
+			stats.stolen.Add();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void SessionScheduler::RunSessionFrame(unsigned int worker, QueuedFrame const& frame)
+{
+	Session& session = *frame.session;
+
+	{
+		std::lock_guard<std::mutex> lock(session.mutex);
+		session.chip8.keypad = session.keys.load(std::memory_order_relaxed);
+		session.chip8.RunFrame(session.cycles);
+	}
+
+	Clock::time_point now = Clock::now();
+	Clock::time_point next = frame.release + session_frame_time;
+
+	stats.frames.Add();
+	stats.response_time.Record(std::chrono::duration_cast<std::chrono::nanoseconds>(now - frame.release));
+	session.frames.fetch_add(1, std::memory_order_relaxed);
+
+	if (now > next)
+	{
+		stats.missed.Add();
+		session.missed.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	//Late frames are run back to back to catch up, but no release is older than the backlog allows. The same
+	//floor for every session keeps the deadline order round robin under overload: a session that was just run
+	//goes behind every session that was run before it
+	Clock::time_point oldest = now - max_backlog_frames * session_frame_time;
+
+	if (next < oldest)
+	{
+		uint64_t behind = static_cast<uint64_t>((oldest - next + session_frame_time - Clock::duration(1)) / session_frame_time);
+		next += behind * session_frame_time;
+
+		stats.skipped.Add(behind);
+		session.skipped.fetch_add(behind, std::memory_order_relaxed);
+	}
+
+	Push(queues[worker], QueuedFrame{ next, &session });
+}
+
+void SessionScheduler::WorkerLoop(unsigned int worker)
+{
+	RunQueue& own = queues[worker];
+	unsigned int victim = worker;
+
+	while (!stopping.load(std::memory_order_relaxed))
+	{
+		Clock::time_point now = Clock::now();
+		Clock::time_point ownRelease = Clock::time_point::max();
+
+		{
+			std::lock_guard<std::mutex> lock(own.mutex);
+
+			if (!own.heap.empty())
+			{
+				ownRelease = own.heap.front().release;
+			}
+		}
+
+		victim = victim + 1 == worker + thread_count ? worker + 1 : victim + 1;
+		QueuedFrame frame;
+		bool found;
+
+		if (ownRelease <= now)
+		{
+			//Busy: one victim per frame, and only frames a whole period older than this worker's, so an
+			//uneven split of sessions evens out under load without the workers trading frames all the time
+			found = thread_count > 1 && Steal(victim, 1, ownRelease - session_frame_time, frame);
+
+			if (!found)
+			{
+				std::lock_guard<std::mutex> lock(own.mutex);
+				found = PopReleased(own, now, frame);
+			}
+		}
+		else
+		{
+			//Idle: any released frame of any other worker
+			found = Steal(worker + 1, thread_count - 1, now, frame);
+		}
+
+		if (found)
+		{
+			RunSessionFrame(worker, frame);
+			continue;
+		}
+
+		std::this_thread::sleep_until(std::min(ownRelease, now + steal_poll));
+	}
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include "chip8.h"
+#include "metrics.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+- Runs many interactive sessions (a Chip8 with its own 60Hz frame clock) on a fixed set of worker threads,
+  instead of one thread sleeping and spinning per session
+- A session frame is released at the start of its 60Hz period and is due at the end of it
+- Every worker has its own run queue, a heap ordered by deadline: a worker runs the earliest deadline among its
+  released frames, and with none released steals a released frame from another worker's queue. A busy worker
+  also steals frames a whole period older than its own. The session then stays with the worker that ran it,
+  so load moves to the workers that have time
+- Every session has the same period, so earliest deadline first is also round robin: no session can starve another
+- Frames finished after their deadline count as missed; no session's next release is more than max_backlog_frames
+  in the past, older frames are skipped (and counted) instead of run as a burst. Under overload every session
+  sits at that floor, so they are run in turn
+*/
+
+//Frames a session may fall behind before it skips ahead
+const unsigned int max_backlog_frames = 4;
+
+struct SchedulerStats
+{
+	MetricsCounter frames;
+	//Finished after the end of their 60Hz period
+	MetricsCounter missed;
+	//Never run, the session was too far behind
+	MetricsCounter skipped;
+	//Run by a worker that took them from another worker's queue
+	MetricsCounter stolen;
+	//Release of a frame to the end of it
+	MetricsHistogram response_time;
+};
+
+struct SessionStats
+{
+	uint64_t frames;
+	uint64_t missed;
+	uint64_t skipped;
+};
+
+class SessionScheduler
+{
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	//threads = 0 -> one worker per hardware thread
+	explicit SessionScheduler(unsigned int threads = 0);
+	~SessionScheduler();
+	//Runs a copy of machine, cycles instructions per frame, from the next frame period on. Returns the session id
+	unsigned int AddSession(Chip8 const& machine, unsigned int cycles);
+	//Keys the session sees from its next frame on
+	void SetKeys(unsigned int id, uint16_t keys);
+	//Copy of the session's machine between two of its frames
+	void Snapshot(unsigned int id, Chip8& out);
+	SessionStats GetSessionStats(unsigned int id);
+	unsigned int SessionCount();
+	void Start();
+	void Stop();
+	SchedulerStats const& Stats() const { return stats; }
+	unsigned int ThreadCount() const { return thread_count; }
+
+private:
+	struct Session
+	{
+		Chip8 chip8;
+		unsigned int cycles{};
+		std::atomic<uint16_t> keys{};
+		//Held while a worker runs a frame, so a snapshot never sees half a frame
+		std::mutex mutex;
+		std::atomic<uint64_t> frames{};
+		std::atomic<uint64_t> missed{};
+		std::atomic<uint64_t> skipped{};
+	};
+
+	struct QueuedFrame
+	{
+		Clock::time_point release;
+		Session* session;
+	};
+
+	//Own cache line each, the workers lock their queues all the time
+	struct alignas(64) RunQueue
+	{
+		std::mutex mutex;
+		std::vector<QueuedFrame> heap;
+	};
+
+	void WorkerLoop(unsigned int worker);
+	bool PopReleased(RunQueue& queue, Clock::time_point now, QueuedFrame& frame);
+	bool Steal(unsigned int first, unsigned int victims, Clock::time_point before, QueuedFrame& frame);
+	void Push(RunQueue& queue, QueuedFrame const& frame);
+	void RunSessionFrame(unsigned int worker, QueuedFrame const& frame);
+	Session& Find(unsigned int id);
+
+	unsigned int thread_count{};
+	std::unique_ptr<RunQueue[]> queues;
+	std::vector<std::thread> workers;
+	std::atomic<bool> stopping{};
+
+	//Sessions never move, queues and workers keep plain pointers to them
+	std::mutex sessions_mutex;
+	std::vector<std::unique_ptr<Session>> sessions;
+
+	SchedulerStats stats;
+};
@@ -0,0 +1,74 @@
+#include "vip_timing.h"
+
+//Machine cycles of each instruction after fetch and decode, Dxyn/Fx55/Fx65 are worked out in Cost
+static const uint16_t instruction_cycles[INSTRUCTION_COUNT] =
+{
+	18,		//NULL (0nnn, machine code routine)
+	24,		//00E0
+	10,		//00EE
+	12,		//1nnn
+	26,		//2nnn
+	10,		//3xkk
+	10,		//4xkk
+	14,		//5xy0
+	6,		//6xkk
+	10,		//7xkk
+	44,		//8xy0
+	44,		//8xy1
+	44,		//8xy2
+	44,		//8xy3
+	44,		//8xy4
+	44,		//8xy5
+	44,		//8xy6
+	44,		//8xy7
+	44,		//8xyE
+	14,		//9xy0
+	12,		//Annn
+	22,		//Bnnn
+	36,		//Cxkk
+	26,		//Dxyn
+	14,		//Ex9E
+	14,		//ExA1
+	10,		//Fx07
+	18,		//Fx0A
+	10,		//Fx15
+	10,		//Fx18
+	18,		//Fx1E
+	20,		//Fx29
+	84,		//Fx33
+	14,		//Fx55
+	14		//Fx65
+};
+
+//Dxyn per sprite row, a sprite not aligned to a byte is shifted and written to two bytes
+const unsigned int dxyn_row_cycles = 34;
+const unsigned int dxyn_unaligned_row_cycles = 68;
+//Fx55/Fx65 per register copied
+const unsigned int fx55_register_cycles = 14;
+
+
+unsigned int VipTiming::Cost(Chip8 const& chip8, Instruction instruction, uint16_t opcode)
+{
+	unsigned int cycles = vip_fetch_cycles + instruction_cycles[instruction];
+
+	switch (instruction)
+	{
+	case INSTRUCTION_Dxyn:
+	{
+		unsigned int rows = opcode & 0x000Fu;
+		bool aligned = (chip8.Register((opcode & 0x0F00u) >> 8u) & 7u) == 0;
+		cycles += rows * (aligned ? dxyn_row_cycles : dxyn_unaligned_row_cycles);
+		break;
+	}
+
+	case INSTRUCTION_Fx55:
+	case INSTRUCTION_Fx65:
+		cycles += (((opcode & 0x0F00u) >> 8u) + 1) * fx55_register_cycles;
+		break;
+
+	default:
+		break;
+	}
+
+	return cycles;
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include "chip8.h"
+#include <cstdint>
+
+/*
+- Timing policy for Chip8::RunFrameTimed that paces instructions like the CHIP-8 interpreter of the COSMAC VIP
+- Time is counted in machine cycles of the VIP's 1802 CPU (8 clocks of its 1.76 MHz clock). Every instruction costs
+  vip_fetch_cycles for the interpreter's fetch and decode plus a cost of its own. Dxyn costs more per row,
+  and twice as much for sprites not aligned to a byte
+- A frame has the machine cycles left over after the display DMA and the 60Hz interrupt. An instruction runs while
+  the frame has cycles left, and overrunning the frame takes the cycles from the next one
+- Dxyn waits for vertical blank: it only runs as the first instruction of a frame, so at most one sprite is drawn per frame
+- The costs are approximations from disassembling the VIP interpreter, close enough for games to run at their real speed
+*/
+
+//1760900 Hz / 8 clocks per machine cycle / 60 Hz
+const unsigned int vip_frame_cycles = 3668;
+//Display DMA (128 lines of 8 bytes) and the interrupt routine
+const unsigned int vip_display_cycles = 1100;
+//Fetch and decode, paid by every instruction
+const unsigned int vip_fetch_cycles = 40;
+
+class VipTiming
+{
+public:
+	//cycles (the instruction count of NoTiming) is not used, the frame length is fixed by the hardware
+	void BeginFrame(unsigned int)
+	{
+		//Cycles left when Dxyn ended the frame were spent waiting, a debt from an overrun is kept
+		budget = (budget < 0 ? budget : 0) + static_cast<int32_t>(vip_frame_cycles - vip_display_cycles);
+		started = false;
+	}
+
+	bool Admit(Chip8 const& chip8, uint16_t opcode)
+	{
+		if (budget <= 0)
+		{
+			return false;
+		}
+
+		Instruction instruction = DecodeInstruction(opcode);
+
+		if (instruction == INSTRUCTION_Dxyn && started)
+		{
+			return false;
+		}
+
+		//The cost depends on the state before the instruction, it is paid by Charge once the instruction ran
+		pending = Cost(chip8, instruction, opcode);
+
+		return true;
+	}
+
+	void Charge()
+	{
+		budget -= static_cast<int32_t>(pending);
+		started = true;
+	}
+
+	//Machine cycles the instruction takes on the VIP in the machine's current state
+	static unsigned int Cost(Chip8 const& chip8, Instruction instruction, uint16_t opcode);
+
+private:
+	//Machine cycles left in this frame
+	int32_t budget{};
+	//An instruction already ran this frame
+	bool started{};
+	//Cost of the instruction admitted last
+	unsigned int pending{};
+};
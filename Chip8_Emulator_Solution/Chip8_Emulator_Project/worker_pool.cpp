@@ -0,0 +1,119 @@
+#include "worker_pool.h"
+
+//Indices are handed out in small chunks so uneven work still balances across threads
+const size_t chunk_size = 4;
+
+
+WorkerPool::WorkerPool(unsigned int threads)
+{
+	if (threads == 0)
+	{
+		threads = std::thread::hardware_concurrency();
+	}
+
+	//The calling thread is one of the workers
+	for (unsigned int i = 1; i < threads; ++i)
+	{
+		workers.emplace_back(&WorkerPool::WorkerLoop, this);
+	}
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(job_mutex);
+		stopping = true;
+	}
+
+	job_ready.notify_all();
+
+	for (std::thread& worker : workers)
+	{
+		worker.join();
+	}
+}
+
+unsigned int WorkerPool::ThreadCount() const
+{
+	return static_cast<unsigned int>(workers.size()) + 1;
+}
+
+void WorkerPool::ParallelFor(size_t count, WorkFunc work, void* context)
+{
+	if (workers.empty() || count <= chunk_size)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			work(context, i);
+		}
+
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(job_mutex);
+		job_work = work;
+		job_context = context;
+		job_count = count;
+		next_index.store(0, std::memory_order_relaxed);
+		busy_workers = static_cast<unsigned int>(workers.size());
+		++generation;
+	}
+
+	job_ready.notify_all();
+
+	RunIndices();
+
+	//Wait until every worker has left the loop before the job can change
+	std::unique_lock<std::mutex> lock(job_mutex);
+	job_done.wait(lock, [this] { return busy_workers == 0; });
+}
+
+void WorkerPool::RunIndices()
+{
+	while (true)
+	{
+		size_t first = next_index.fetch_add(chunk_size, std::memory_order_relaxed);
+
+		if (first >= job_count)
+		{
+			return;
+		}
+
+		size_t last = first + chunk_size < job_count ? first + chunk_size : job_count;
+
+		for (size_t i = first; i < last; ++i)
+		{
+			job_work(job_context, i);
+		}
+	}
+}
+
+void WorkerPool::WorkerLoop()
+{
+	unsigned long long seen = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(job_mutex);
+			job_ready.wait(lock, [&] { return stopping || generation != seen; });
+
+			if (stopping)
+			{
+				return;
+			}
+
+			seen = generation;
+		}
+
+		RunIndices();
+
+		{
+			std::lock_guard<std::mutex> lock(job_mutex);
+			--busy_workers;
+		}
+
+		job_done.notify_one();
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+- Fixed set of threads that run one parallel loop at a time
+- ParallelFor(count, work, context) calls work(context, i) for every i in [0, count)
+- Work is a plain function pointer so starting a loop never allocates
+- The calling thread takes part in the loop and returns once every index has finished
+*/
+
+class WorkerPool
+{
+public:
+	typedef void (*WorkFunc)(void* context, size_t index);
+
+	//threads = 0 -> one thread per hardware thread (the caller counts as one)
+	explicit WorkerPool(unsigned int threads = 0);
+	~WorkerPool();
+	void ParallelFor(size_t count, WorkFunc work, void* context);
+	unsigned int ThreadCount() const;
+
+private:
+	void WorkerLoop();
+	void RunIndices();
+
+	std::vector<std::thread> workers;
+	std::mutex job_mutex;
+	std::condition_variable job_ready;
+	std::condition_variable job_done;
+
+	//Current loop, only changed while no worker is inside it
+	WorkFunc job_work{};
+	void* job_context{};
+	size_t job_count{};
+	std::atomic<size_t> next_index{};
+	unsigned int busy_workers{};
+	unsigned long long generation{};
+	bool stopping{};
+};
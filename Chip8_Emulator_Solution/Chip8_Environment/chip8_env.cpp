@@ -0,0 +1,156 @@
+#include "chip8_env.h"
+#include "../Chip8_Emulator_Project/chip8.h"
+#include "../Chip8_Emulator_Project/worker_pool.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+static_assert(CHIP8_ENV_OBSERVATION_SIZE == VIDEO_PACKED_SIZE, "Observation size must match the packed display");
+
+
+struct chip8_env
+{
+	Chip8 chip8;
+	std::shared_ptr<Chip8 const> boot;
+	unsigned int cycles_per_frame;
+	uint64_t frame_count;
+	uint64_t seed;
+};
+
+//Post-boot machines by ROM path, shared by every environment of that ROM
+static std::mutex boot_mutex;
+static std::map<std::string, std::weak_ptr<Chip8 const>> boot_cache;
+
+//The pool runs one loop at a time: held for the whole of every step/reset batch, so batches from several
+//threads run one after the other instead of overwriting each other's job, and while the pool is replaced
+static std::mutex pool_mutex;
+static unsigned int pool_threads = 0;
+static std::unique_ptr<WorkerPool> pool;
+
+
+//Caller holds pool_mutex
+static WorkerPool& Pool()
+{
+	if (!pool)
+	{
+		pool.reset(new WorkerPool(pool_threads));
+	}
+
+	return *pool;
+}
+
+
+struct StepJob
+{
+	chip8_env* const* envs;
+	uint16_t const* actions;
+	uint64_t const* seeds;
+	unsigned int frames;
+	uint8_t* observations;
+};
+
+static void StepOne(void* context, size_t i)
+{
+	StepJob& job = *static_cast<StepJob*>(context);
+	chip8_env& env = *job.envs[i];
+
+	env.chip8.keypad = job.actions[i];
+
+	for (unsigned int frame = 0; frame < job.frames; ++frame)
+	{
+		env.chip8.RunFrame(env.cycles_per_frame);
+	}
+
+	env.frame_count += job.frames;
+	env.chip8.PackVideo(&job.observations[i * VIDEO_PACKED_SIZE]);
+}
+
+static void ResetOne(void* context, size_t i)
+{
+	StepJob& job = *static_cast<StepJob*>(context);
+	chip8_env& env = *job.envs[i];
+
+	if (job.seeds)
+	{
+		env.seed = job.seeds[i];
+	}
+
+	env.chip8 = *env.boot;
+	env.chip8.Seed(env.seed);
+	env.frame_count = 0;
+
+	if (job.observations)
+	{
+		env.chip8.PackVideo(&job.observations[i * VIDEO_PACKED_SIZE]);
+	}
+}
+
+
+extern "C" {
+
+void chip8_env_set_threads(unsigned int threads)
+{
+	std::lock_guard<std::mutex> lock(pool_mutex);
+
+	//The next batch starts a pool of the new size
+	if (threads != pool_threads)
+	{
+		pool_threads = threads;
+		pool.reset();
+	}
+}
+
+chip8_env* chip8_env_create(char const* rom_path, unsigned int cycles_per_frame, uint64_t seed)
+{
+	std::shared_ptr<Chip8 const> boot;
+
+	{
+		std::lock_guard<std::mutex> lock(boot_mutex);
+		boot = boot_cache[rom_path].lock();
+
+		if (!boot)
+		{
+			std::shared_ptr<Chip8> loaded(new Chip8);
+
+			if (!loaded->open_ROM(rom_path))
+			{
+				return nullptr;
+			}
+
+			boot = loaded;
+			boot_cache[rom_path] = boot;
+		}
+	}
+
+	chip8_env* env = new chip8_env{ *boot, boot, cycles_per_frame, 0, seed };
+	env->chip8.Seed(seed);
+
+	return env;
+}
+
+void chip8_env_destroy(chip8_env* env)
+{
+	delete env;
+}
+
+void chip8_env_step(chip8_env* const* envs, uint16_t const* actions, size_t count, unsigned int frames, uint8_t* observations)
+{
+	StepJob job{ envs, actions, nullptr, frames, observations };
+	std::lock_guard<std::mutex> lock(pool_mutex);
+	Pool().ParallelFor(count, &StepOne, &job);
+}
+
+void chip8_env_reset(chip8_env* const* envs, uint64_t const* seeds, size_t count, uint8_t* observations)
+{
+	StepJob job{ envs, nullptr, seeds, 0, observations };
+	std::lock_guard<std::mutex> lock(pool_mutex);
+	Pool().ParallelFor(count, &ResetOne, &job);
+}
+
+uint64_t chip8_env_frame_count(chip8_env const* env)
+{
+	return env->frame_count;
+}
+
+}
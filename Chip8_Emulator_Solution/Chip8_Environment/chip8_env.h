@@ -0,0 +1,50 @@
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+- C interface for training agents on CHIP-8 games, built from the emulator core without SDL
+- An observation is the display packed at 1 bit per pixel: 32 rows of 8 bytes, most significant bit is the leftmost pixel
+- An action is the keypad as a bit mask (bit n = key n is down) held for the whole step
+- Environments made from the same ROM share one post-boot snapshot, reset copies it instead of reloading the ROM
+- Step and reset never allocate; batches are spread over a shared pool of threads
+- Any thread may call any function. Step and reset batches share the pool, so batches from several threads run
+  one at a time (each still on every pool thread); an env must not be in two batches that run at the same time
+*/
+
+#ifdef _WIN32
+#define CHIP8_ENV_API __declspec(dllexport)
+#else
+#define CHIP8_ENV_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct chip8_env chip8_env;
+
+#define CHIP8_ENV_OBSERVATION_SIZE 256
+
+//Threads used by step/reset, 0 = one per hardware thread. Waits for a running batch, the pool is restarted
+//with the new size on the next one
+CHIP8_ENV_API void chip8_env_set_threads(unsigned int threads);
+
+//cycles_per_frame instructions run per 60Hz frame, seed drives the random numbers (Cxkk) of the env,
+//NULL if the ROM cannot be loaded
+CHIP8_ENV_API chip8_env* chip8_env_create(char const* rom_path, unsigned int cycles_per_frame, uint64_t seed);
+CHIP8_ENV_API void chip8_env_destroy(chip8_env* env);
+
+//Advances envs[i] by frames frames with actions[i] held, observations holds count * CHIP8_ENV_OBSERVATION_SIZE bytes
+CHIP8_ENV_API void chip8_env_step(chip8_env* const* envs, uint16_t const* actions, size_t count, unsigned int frames, uint8_t* observations);
+
+//Restores envs to the post-boot snapshot seeded with seeds[i], or with the env's last seed when seeds is NULL
+//(so an episode replays exactly), observations may be NULL
+CHIP8_ENV_API void chip8_env_reset(chip8_env* const* envs, uint64_t const* seeds, size_t count, uint8_t* observations);
+
+//Frames emulated since the last reset
+CHIP8_ENV_API uint64_t chip8_env_frame_count(chip8_env const* env);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,370 @@
+// In-process fuzz target for the instruction core
+//
+// Build with clang -fsanitize=fuzzer,address -DCHIP8_LIBFUZZER to run under libFuzzer (without the define
+// the built-in main below is linked instead of libFuzzer's), or without both (ideally with
+// -fsanitize=address,undefined) to use the built-in coverage guided loop:
+// fuzzer <Corpus Directory> [Seconds] [Seed ROM ...]
+//
+// Input layout:
+//	byte 0           -> number of key frames k (0 - 31)
+//	next 2 * k bytes -> keypad masks (little endian, bit n = key n), frame f uses mask f % k
+//	rest             -> ROM loaded at 0x200
+#include "../Chip8_Emulator_Project/chip8.h"
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+
+const unsigned int fuzz_frames = 64;
+const unsigned int fuzz_cycles_per_frame = 10;
+const unsigned int max_key_frames = 31;
+
+//Coverage, like AFL: edges between consecutive instructions, and between a control flow instruction and the
+//page (and odd or even address) it went to. Exact addresses are left out, every random jump target would be new
+//coverage and the corpus would fill with ROMs that differ only in where they jump. A run counts how often it
+//takes each edge, and only a count reaching a new bucket (1, 2, 3, 4-7, 8-15, 16-31, 32-127, 128+) of an edge
+//is new coverage
+const unsigned int edge_map_size = 1 << 16;
+//Hits of every edge in the current run, and the edges hit (so clearing it doesn't cost 64KB per run)
+static uint8_t run_map[edge_map_size];
+static std::vector<uint16_t> run_edges;
+//Buckets ever reached per edge, one bit each
+static uint8_t bucket_map[edge_map_size];
+//Buckets reached so far, and whether the current run reached one for the first time
+static size_t coverage_count = 0;
+static bool new_coverage = false;
+
+
+static void Hit(unsigned int edge)
+{
+	uint8_t& count = run_map[edge & (edge_map_size - 1)];
+
+	if (count == 0)
+	{
+		run_edges.push_back(static_cast<uint16_t>(edge & (edge_map_size - 1)));
+	}
+
+	if (count != 0xFF)
+	{
+		++count;
+	}
+}
+
+static uint8_t Bucket(uint8_t count)
+{
+	if (count <= 3) return 1u << (count - 1);
+	if (count <= 7) return 1u << 3;
+	if (count <= 15) return 1u << 4;
+	if (count <= 31) return 1u << 5;
+	if (count <= 127) return 1u << 6;
+	return 1u << 7;
+}
+
+//Merges the run's edge counts into the bucket map and clears them for the next run
+static void MergeCoverage()
+{
+	for (uint16_t edge : run_edges)
+	{
+		uint8_t bucket = Bucket(run_map[edge]);
+		run_map[edge] = 0;
+
+		if (!(bucket_map[edge] & bucket))
+		{
+			bucket_map[edge] |= bucket;
+			++coverage_count;
+			new_coverage = true;
+		}
+	}
+
+	run_edges.clear();
+}
+
+//Runs one input on a copy of a pre-initialized machine, recording coverage into the maps
+static void RunOne(uint8_t const* data, size_t size)
+{
+	//Fonts and dispatch tables are set up once, each run only copies the machine
+	static Chip8 const initial;
+
+	if (size == 0)
+	{
+		return;
+	}
+
+	unsigned int key_frames = data[0] % (max_key_frames + 1);
+	size_t keys_size = 1 + key_frames * 2;
+
+	if (size < keys_size)
+	{
+		return;
+	}
+
+	size_t rom_size = size - keys_size;
+
+	if (rom_size > ROM_MAX_SIZE)
+	{
+		rom_size = ROM_MAX_SIZE;
+	}
+
+	Chip8 chip8 = initial;
+	chip8.load_ROM(data + keys_size, rom_size);
+
+	uint16_t previous_pc = chip8.ProgramCounter();
+	unsigned int previous_class = INSTRUCTION_NULL;
+	run_edges.reserve(edge_map_size);
+
+	for (unsigned int frame = 0; frame < fuzz_frames; ++frame)
+	{
+		if (key_frames)
+		{
+			unsigned int k = frame % key_frames;
+			chip8.keypad = data[1 + k * 2] | (data[2 + k * 2] << 8u);
+		}
+
+		for (unsigned int cycle = 0; cycle < fuzz_cycles_per_frame; ++cycle)
+		{
+			chip8.Step();
+
+			uint16_t pc = chip8.ProgramCounter() & (MEMORY_SIZE - 1);
+			unsigned int opcode_class = DecodeInstruction(chip8.Opcode());
+
+			//Jumps, calls, returns and skips, by the page and alignment they went to; the class edges are kept
+			//apart in the upper half of the map
+			if (pc != ((previous_pc + 2u) & (MEMORY_SIZE - 1)))
+			{
+				Hit((opcode_class << 5u) | ((pc >> 8u) << 1u) | (pc & 1u));
+			}
+
+			Hit((previous_class * INSTRUCTION_COUNT + opcode_class) | 0x8000u);
+
+			previous_pc = pc;
+			previous_class = opcode_class;
+		}
+
+		chip8.TickTimers();
+	}
+
+	MergeCoverage();
+}
+
+
+extern "C" int LLVMFuzzerTestOneInput(uint8_t const* data, size_t size)
+{
+	RunOne(data, size);
+	return 0;
+}
+
+
+#ifndef CHIP8_LIBFUZZER
+
+//Input currently running, written out if the process dies. The handler may only make async-signal-safe
+//calls, so the crash file is opened up front and the handler only writes to it
+static int crash_file = -1;
+static uint8_t const* volatile crash_data = nullptr;
+static volatile size_t crash_size = 0;
+
+static void OnCrash(int signal_number)
+{
+	if (crash_data && crash_file >= 0)
+	{
+		if (write(crash_file, crash_data, static_cast<unsigned int>(crash_size)) < 0)
+		{
+			//Nothing left to report it to
+		}
+	}
+
+	std::signal(signal_number, SIG_DFL);
+	std::raise(signal_number);
+}
+
+static bool WriteInput(std::string const& path, std::vector<uint8_t> const& input)
+{
+	std::ofstream file(path, std::ios::binary);
+	file.write(reinterpret_cast<char const*>(input.data()), input.size());
+	file.close();
+
+	return !file.fail();
+}
+
+static void Mutate(std::vector<uint8_t>& input, std::vector<std::vector<uint8_t>> const& corpus, std::mt19937& rng)
+{
+	unsigned int mutations = 1 + rng() % 4;
+
+	for (unsigned int m = 0; m < mutations; ++m)
+	{
+		if (input.empty())
+		{
+			input.push_back(0);
+		}
+
+		size_t at = rng() % input.size();
+
+		switch (rng() % 7)
+		{
+		case 0: input[at] ^= 1u << (rng() % 8); break;
+		case 1: input[at] = rng(); break;
+		case 2: input.insert(input.begin() + at, static_cast<uint8_t>(rng())); break;
+		case 3: if (input.size() > 1) input.erase(input.begin() + at); break;
+		//Whole instructions: high nibble chosen so every opcode group is reached
+		case 4:
+		{
+			input[at] = ((rng() % 16) << 4u) | (rng() % 16);
+			if (at + 1 < input.size()) input[at + 1] = rng();
+		} break;
+		//Addresses that point back into the ROM
+		case 5:
+		{
+			input[at] = (input[at] & 0xF0u) | (0x2u + rng() % 14);
+		} break;
+		//Splice with another corpus entry
+		case 6:
+		{
+			std::vector<uint8_t> const& other = corpus[rng() % corpus.size()];
+			if (!other.empty())
+			{
+				size_t from = rng() % other.size();
+				size_t count = std::min<size_t>(other.size() - from, 1 + rng() % 32);
+				input.insert(input.begin() + at, other.begin() + from, other.begin() + from + count);
+			}
+		} break;
+		}
+	}
+
+	if (input.size() > 1 + max_key_frames * 2 + ROM_MAX_SIZE)
+	{
+		input.resize(1 + max_key_frames * 2 + ROM_MAX_SIZE);
+	}
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " <Corpus Directory> [Seconds] [Seed ROM ...]\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	std::string corpus_dir = argv[1];
+	double seconds = argc > 2 ? std::atof(argv[2]) : 60.0;
+
+	std::string crash_path = corpus_dir + "/crash.bin";
+
+	//New inputs are only worth finding if they can be kept
+	std::string probe = corpus_dir + "/.probe";
+
+	if (!WriteInput(probe, std::vector<uint8_t>()))
+	{
+		std::cerr << "Corpus directory is missing or not writable: " << corpus_dir << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	std::remove(probe.c_str());
+
+#ifdef O_BINARY
+	crash_file = open(crash_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_BINARY, 0644);
+#else
+	crash_file = open(crash_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+
+	if (crash_file < 0)
+	{
+		std::cerr << "Could not create " << crash_path << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	std::signal(SIGSEGV, OnCrash);
+	std::signal(SIGABRT, OnCrash);
+	std::signal(SIGFPE, OnCrash);
+
+	//Seeds: ROMs given on the command line (no key frames) or one empty input
+	std::vector<std::vector<uint8_t>> corpus;
+
+	for (int i = 3; i < argc; ++i)
+	{
+		std::ifstream rom(argv[i], std::ios::binary);
+		std::vector<uint8_t> seed(1, 0);
+		seed.insert(seed.end(), std::istreambuf_iterator<char>(rom), std::istreambuf_iterator<char>());
+		corpus.push_back(seed);
+	}
+
+	if (corpus.empty())
+	{
+		corpus.push_back(std::vector<uint8_t>(1, 0));
+	}
+
+	for (std::vector<uint8_t> const& seed : corpus)
+	{
+		RunOne(seed.data(), seed.size());
+	}
+
+	std::mt19937 rng(12345);
+	std::vector<uint8_t> input;
+	unsigned long long executions = 0;
+
+	auto start = std::chrono::steady_clock::now();
+	auto last_report = start;
+
+	while (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < seconds)
+	{
+		input = corpus[rng() % corpus.size()];
+		Mutate(input, corpus, rng);
+
+		crash_data = input.data();
+		crash_size = input.size();
+		new_coverage = false;
+		RunOne(input.data(), input.size());
+		crash_data = nullptr;
+		++executions;
+
+		//The bucket map only ever fills up, an input that reached a bucket is the only chance to keep that coverage
+		if (new_coverage)
+		{
+			corpus.push_back(input);
+
+			std::string path = corpus_dir + "/input_" + std::to_string(corpus.size()) + ".bin";
+
+			if (!WriteInput(path, input))
+			{
+				std::cerr << "Could not write " << path << "\n";
+				std::exit(EXIT_FAILURE);
+			}
+		}
+
+		auto now = std::chrono::steady_clock::now();
+
+		if (std::chrono::duration<double>(now - last_report).count() >= 5.0)
+		{
+			last_report = now;
+			double elapsed = std::chrono::duration<double>(now - start).count();
+
+			std::cout << "execs " << executions
+				<< "  execs/s " << static_cast<unsigned long>(executions / elapsed)
+				<< "  coverage " << coverage_count
+				<< "  corpus " << corpus.size() << "\n";
+		}
+	}
+
+	std::cout << "done: " << executions << " executions, coverage " << coverage_count << ", corpus " << corpus.size() << "\n";
+
+	//Nothing crashed, no empty crash file is left behind
+	close(crash_file);
+	std::remove(crash_path.c_str());
+
+	return 0;
+}
+
+#endif
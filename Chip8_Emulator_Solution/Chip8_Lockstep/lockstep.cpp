@@ -0,0 +1,419 @@
+// Runs the reference interpreter (Chip8::Step) and another execution backend side by side on the same ROMs and keys
+// and reports the first instruction where their states differ
+#include "../Chip8_Emulator_Project/chip8.h"
+#include "../Chip8_Emulator_Project/debugger.h"
+#include "../Chip8_Emulator_Project/worker_pool.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+/*
+- Both machines start from the same loaded machine and get the same keys before every instruction
+- Every <Check> instructions the state hashes are compared and, when equal, both machines are snapshotted
+- A mismatch is bisected between the last snapshot and the check: replaying from the snapshots finds
+  the instruction after which the hashes first differ, then both states are printed
+- ROMs are spread over a worker pool, each ROM is one independent run
+*/
+
+enum Backend
+{
+	BACKEND_REFERENCE,
+	BACKEND_CACHED,
+	BACKEND_PREDECODED,
+	BACKEND_HOOKED,
+	//Whatever open_ROM picked for the ROM
+	BACKEND_SELECTED
+};
+
+struct Options
+{
+	Backend backend{ BACKEND_CACHED };
+	uint64_t instructions{ 10000000 };
+	unsigned int check{ 1024 };
+	unsigned int cycles{ 10 };
+	//Keys change every key_frames frames
+	unsigned int keyFrames{ 8 };
+	uint64_t seed{ 1 };
+	//Compare hashes computed from scratch instead of the incremental ones
+	bool fullHash{};
+};
+
+//Hooks that do something, so the hooked path is not the NoHooks instantiation Step already uses
+struct CountingHooks
+{
+	uint64_t count{};
+
+	bool BeforeExecute(Chip8 const&, uint16_t, uint16_t)
+	{
+		++count;
+		return true;
+	}
+};
+
+struct Machine
+{
+	Chip8 chip8;
+	CountingHooks hooks;
+};
+
+struct Job
+{
+	char** roms;
+	Options const* options;
+	std::vector<std::string>* reports;
+	std::vector<uint64_t>* instructions;
+	std::vector<char>* diverged;
+};
+
+
+static uint64_t Mix(uint64_t value)
+{
+	value ^= value >> 33u;
+	value *= 0xFF51AFD7ED558CCDull;
+	value ^= value >> 33u;
+	value *= 0xC4CEB9FE1A85EC53ull;
+	value ^= value >> 33u;
+	return value;
+}
+
+//Keys held during a frame, a pure function of the frame so any instruction can be replayed
+//Each key is down about one frame in eight
+static uint16_t KeysAt(Options const& options, uint64_t frame)
+{
+	uint64_t block = frame / options.keyFrames;
+	uint64_t a = Mix(options.seed ^ (block * 3 + 0));
+	uint64_t b = Mix(options.seed ^ (block * 3 + 1));
+	uint64_t c = Mix(options.seed ^ (block * 3 + 2));
+
+	return static_cast<uint16_t>(a & b & c);
+}
+
+//Instruction number <step> of the run: keys, one instruction, and the timer tick at the end of a frame
+static void Advance(Machine& machine, Backend backend, Options const& options, uint64_t step)
+{
+	Chip8& chip8 = machine.chip8;
+	chip8.keypad = KeysAt(options, step / options.cycles);
+
+	switch (backend)
+	{
+	case BACKEND_REFERENCE:
+		chip8.Step();
+		break;
+
+	case BACKEND_CACHED:
+		chip8.StepCached();
+		break;
+
+	case BACKEND_PREDECODED:
+		chip8.StepPredecoded();
+		break;
+
+	case BACKEND_HOOKED:
+		chip8.StepHooked(machine.hooks);
+		break;
+
+	case BACKEND_SELECTED:
+		chip8.StepSelected();
+		break;
+	}
+
+	if ((step + 1) % options.cycles == 0)
+	{
+		chip8.TickTimers();
+	}
+}
+
+static bool Diverged(Machine const& reference, Machine const& candidate, Options const& options)
+{
+	if (options.fullHash)
+	{
+		return reference.chip8.ComputeStateHash() != candidate.chip8.ComputeStateHash();
+	}
+
+	return reference.chip8.StateHash() != candidate.chip8.StateHash();
+}
+
+//States after replaying count instructions from the snapshots taken at instruction first
+static void Replay(Machine& reference, Machine& candidate, Machine const& referenceSnapshot, Machine const& candidateSnapshot,
+	Options const& options, uint64_t first, uint64_t count)
+{
+	reference = referenceSnapshot;
+	candidate = candidateSnapshot;
+
+	for (uint64_t step = first; step < first + count; ++step)
+	{
+		Advance(reference, BACKEND_REFERENCE, options, step);
+		Advance(candidate, options.backend, options, step);
+	}
+}
+
+static void PrintState(char const* name, Chip8 const& chip8, Debugger const& printer, std::ostream& out)
+{
+	out << name << ":\n";
+	printer.PrintRegisters(chip8, out);
+	printer.PrintStack(chip8, out);
+}
+
+static void PrintDifferences(Chip8 const& reference, Chip8 const& candidate, std::ostream& out)
+{
+	const unsigned int max_listed = 16;
+	unsigned int listed = 0;
+	unsigned int differing = 0;
+
+	for (unsigned int address = 0; address < MEMORY_SIZE; ++address)
+	{
+		uint8_t expected = reference.ReadMemory(address);
+		uint8_t actual = candidate.ReadMemory(address);
+
+		if (expected != actual)
+		{
+			if (listed++ < max_listed)
+			{
+				out << "  memory[0x" << std::hex << address << "] reference 0x" << unsigned(expected)
+					<< " candidate 0x" << unsigned(actual) << std::dec << "\n";
+			}
+
+			++differing;
+		}
+	}
+
+	unsigned int pixels = 0;
+
+	for (unsigned int i = 0; i < VIDEO_WIDTH * VIDEO_HEIGHT; ++i)
+	{
+		if ((reference.video[i] != 0) != (candidate.video[i] != 0))
+		{
+			++pixels;
+		}
+	}
+
+	out << "  " << differing << " bytes of memory and " << pixels << " pixels differ\n";
+}
+
+//Smallest count in (0, span] whose replay diverges, given that replaying span instructions does
+static uint64_t Bisect(Machine& reference, Machine& candidate, Machine const& referenceSnapshot, Machine const& candidateSnapshot,
+	Options const& options, uint64_t first, uint64_t span)
+{
+	uint64_t same = 0;
+	uint64_t different = span;
+
+	while (different - same > 1)
+	{
+		uint64_t middle = same + (different - same) / 2;
+		Replay(reference, candidate, referenceSnapshot, candidateSnapshot, options, first, middle);
+
+		if (Diverged(reference, candidate, options))
+		{
+			different = middle;
+		}
+		else
+		{
+			same = middle;
+		}
+	}
+
+	return different;
+}
+
+static void RunRom(void* context, size_t index)
+{
+	Job& job = *static_cast<Job*>(context);
+	Options const& options = *job.options;
+	char const* rom = job.roms[index];
+	std::ostringstream out;
+
+	//Machines are about 12KB, keep them off the worker stacks
+	std::unique_ptr<Machine[]> machines(new Machine[4]);
+	Machine& reference = machines[0];
+	Machine& candidate = machines[1];
+	Machine& referenceSnapshot = machines[2];
+	Machine& candidateSnapshot = machines[3];
+
+	if (!reference.chip8.open_ROM(rom))
+	{
+		out << rom << ": could not load\n";
+		(*job.reports)[index] = out.str();
+		(*job.diverged)[index] = 1;
+		return;
+	}
+
+	//Copies share everything, including the state behind Cxkk
+	reference.chip8.Seed(options.seed);
+	candidate = reference;
+	referenceSnapshot = reference;
+	candidateSnapshot = candidate;
+
+	uint64_t snapshotStep = 0;
+	uint64_t step = 0;
+
+	for (; step < options.instructions; ++step)
+	{
+		Advance(reference, BACKEND_REFERENCE, options, step);
+		Advance(candidate, options.backend, options, step);
+
+		if ((step + 1 - snapshotStep) < options.check && step + 1 < options.instructions)
+		{
+			continue;
+		}
+
+		if (!Diverged(reference, candidate, options))
+		{
+			referenceSnapshot = reference;
+			candidateSnapshot = candidate;
+			snapshotStep = step + 1;
+			continue;
+		}
+
+		uint64_t count = Bisect(reference, candidate, referenceSnapshot, candidateSnapshot, options, snapshotStep, step + 1 - snapshotStep);
+		uint64_t failing = snapshotStep + count - 1;
+
+		//State right before the failing instruction, then right after it
+		Replay(reference, candidate, referenceSnapshot, candidateSnapshot, options, snapshotStep, count - 1);
+
+		Debugger printer;
+		out << rom << ": diverged at instruction " << failing << " (frame " << failing / options.cycles << ", keys 0x"
+			<< std::hex << KeysAt(options, failing / options.cycles) << std::dec << ")\n";
+		printer.PrintInstruction(reference.chip8, reference.chip8.ProgramCounter(), out);
+
+		Advance(reference, BACKEND_REFERENCE, options, failing);
+		Advance(candidate, options.backend, options, failing);
+
+		PrintState("reference", reference.chip8, printer, out);
+		PrintState("candidate", candidate.chip8, printer, out);
+		PrintDifferences(reference.chip8, candidate.chip8, out);
+
+		(*job.reports)[index] = out.str();
+		(*job.instructions)[index] = failing + 1;
+		(*job.diverged)[index] = 1;
+		return;
+	}
+
+	//A backend that changes memory or the display without going through the hashed paths would go unseen
+	for (Machine const* machine : { &reference, &candidate })
+	{
+		if (machine->chip8.StateHash() != machine->chip8.ComputeStateHash())
+		{
+			out << rom << ": incremental state hash of the " << (machine == &reference ? "reference" : "candidate")
+				<< " does not match its contents\n";
+			(*job.reports)[index] = out.str();
+			(*job.instructions)[index] = step;
+			(*job.diverged)[index] = 1;
+			return;
+		}
+	}
+
+	out << rom << ": " << step << " instructions match (" << EngineName(reference.chip8.SelectedEngine()) << " selected)\n";
+	(*job.reports)[index] = out.str();
+	(*job.instructions)[index] = step;
+}
+
+
+int main(int argc, char** argv)
+{
+	Options options;
+	unsigned int threads = 0;
+	int first = 1;
+
+	for (; first < argc && argv[first][0] == '-'; ++first)
+	{
+		bool hasValue = first + 1 < argc;
+
+		if (std::strcmp(argv[first], "-backend") == 0 && hasValue)
+		{
+			char const* name = argv[++first];
+
+			if (std::strcmp(name, "cached") == 0)
+			{
+				options.backend = BACKEND_CACHED;
+			}
+			else if (std::strcmp(name, "predecoded") == 0)
+			{
+				options.backend = BACKEND_PREDECODED;
+			}
+			else if (std::strcmp(name, "hooked") == 0)
+			{
+				options.backend = BACKEND_HOOKED;
+			}
+			else if (std::strcmp(name, "selected") == 0)
+			{
+				options.backend = BACKEND_SELECTED;
+			}
+			else
+			{
+				std::cerr << "Unknown backend: " << name << "\n";
+				std::exit(EXIT_FAILURE);
+			}
+		}
+		else if (std::strcmp(argv[first], "-instructions") == 0 && hasValue)
+		{
+			options.instructions = std::strtoull(argv[++first], nullptr, 10);
+		}
+		else if (std::strcmp(argv[first], "-check") == 0 && hasValue)
+		{
+			options.check = std::atoi(argv[++first]);
+		}
+		else if (std::strcmp(argv[first], "-cycles") == 0 && hasValue)
+		{
+			options.cycles = std::atoi(argv[++first]);
+		}
+		else if (std::strcmp(argv[first], "-seed") == 0 && hasValue)
+		{
+			options.seed = std::strtoull(argv[++first], nullptr, 10);
+		}
+		else if (std::strcmp(argv[first], "-full") == 0)
+		{
+			options.fullHash = true;
+		}
+		else if (std::strcmp(argv[first], "-threads") == 0 && hasValue)
+		{
+			threads = std::atoi(argv[++first]);
+		}
+		else
+		{
+			std::cerr << "Unknown option: " << argv[first] << "\n";
+			std::exit(EXIT_FAILURE);
+		}
+	}
+
+	if (first == argc || options.check == 0 || options.cycles == 0)
+	{
+		std::cerr << "Usage: " << argv[0] << " [-backend cached|predecoded|hooked|selected] [-instructions <N>] [-check <Instructions>]"
+			" [-cycles <Per frame>] [-seed <N>] [-full] [-threads <N>] <ROM> [ROM...]\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	size_t count = argc - first;
+	std::vector<std::string> reports(count);
+	std::vector<uint64_t> instructions(count);
+	std::vector<char> diverged(count);
+
+	Job job{ &argv[first], &options, &reports, &instructions, &diverged };
+
+	auto start = std::chrono::steady_clock::now();
+
+	WorkerPool pool(threads);
+	pool.ParallelFor(count, RunRom, &job);
+
+	double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	uint64_t total = 0;
+	size_t failures = 0;
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		std::cout << reports[i];
+		total += instructions[i];
+		failures += diverged[i];
+	}
+
+	std::cout << count << " ROMs, " << failures << " failed, " << total << " instructions in " << seconds << " s ("
+		<< total / seconds / 1e6 << " M instructions/s per backend)\n";
+
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,271 @@
+// Finds the addresses of game variables by running many copies of a ROM and filtering memory between snapshots
+#include "../Chip8_Emulator_Project/chip8.h"
+#include "../Chip8_Emulator_Project/heatmap.h"
+#include "../Chip8_Emulator_Project/ram_search.h"
+#include "../Chip8_Emulator_Project/worker_pool.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+
+/*
+- Every instance runs the same ROM with its own Cxkk seed and its own random keys, so a counter that
+  only changes with the game (score, lives) is told apart from bytes that happen to change in one run
+- Each filter compares every instance's memory now against its memory at the previous filter,
+  an address stays a candidate only when the compare holds in all of them
+- Instance 0 counts its memory accesses, "heat" writes them out
+*/
+
+//Instances keep their keys for this many frames
+const unsigned int key_frames = 8;
+//Candidates printed by "list" when no count is given
+const unsigned int default_listed = 32;
+//Instances whose values "list" shows
+const unsigned int listed_instances = 4;
+
+struct Instance
+{
+	Chip8 chip8;
+	uint64_t keyState{};
+	uint64_t frame{};
+};
+
+struct Session
+{
+	std::unique_ptr<Instance[]> instances;
+	size_t count{};
+	unsigned int cycles{};
+	unsigned int frames{};
+	//Memory of every instance at the last filter, MEMORY_SIZE bytes each
+	std::vector<uint8_t> previous;
+	RamSearch search;
+	MemoryHeatmap heatmap;
+};
+
+
+//xorshift64*, a different key pattern per instance
+static uint16_t NextKeys(uint64_t& state)
+{
+	state ^= state >> 12u;
+	state ^= state << 25u;
+	state ^= state >> 27u;
+	uint64_t value = state * 0x2545F4914F6CDD1Dull;
+
+	//About one key in eight down
+	return static_cast<uint16_t>(value & (value >> 16u) & (value >> 32u));
+}
+
+static void RunInstance(void* context, size_t index)
+{
+	Session& session = *static_cast<Session*>(context);
+	Instance& instance = session.instances[index];
+
+	for (unsigned int frame = 0; frame < session.frames; ++frame, ++instance.frame)
+	{
+		if (instance.frame % key_frames == 0)
+		{
+			instance.chip8.keypad = NextKeys(instance.keyState);
+		}
+
+		instance.chip8.RunFrame(session.cycles);
+	}
+}
+
+static void Snapshot(Session& session)
+{
+	for (size_t i = 0; i < session.count; ++i)
+	{
+		memcpy(&session.previous[i * MEMORY_SIZE], session.instances[i].chip8.Memory(), MEMORY_SIZE);
+	}
+}
+
+//The snapshot of an instance is taken right after comparing it, while its memory is still in cache
+static void Filter(Session& session, SearchCompare compare)
+{
+	for (size_t i = 0; i < session.count; ++i)
+	{
+		uint8_t* previous = &session.previous[i * MEMORY_SIZE];
+		session.search.Compare(previous, session.instances[i].chip8.Memory(), compare);
+		memcpy(previous, session.instances[i].chip8.Memory(), MEMORY_SIZE);
+	}
+}
+
+static void FilterValue(Session& session, SearchCompare compare, uint8_t value)
+{
+	for (size_t i = 0; i < session.count; ++i)
+	{
+		session.search.CompareValue(session.instances[i].chip8.Memory(), compare, value);
+		memcpy(&session.previous[i * MEMORY_SIZE], session.instances[i].chip8.Memory(), MEMORY_SIZE);
+	}
+}
+
+static void List(Session const& session, unsigned int max)
+{
+	unsigned int listed = 0;
+
+	for (unsigned int address = 0; address < MEMORY_SIZE && listed < max; ++address)
+	{
+		if (!session.search.IsCandidate(address))
+		{
+			continue;
+		}
+
+		std::cout << "  0x" << std::hex << address << ":";
+
+		for (size_t i = 0; i < session.count && i < listed_instances; ++i)
+		{
+			std::cout << " " << unsigned(session.instances[i].chip8.Memory()[address]);
+		}
+
+		std::cout << std::dec << "\n";
+		++listed;
+	}
+}
+
+static bool WriteHeatmap(MemoryHeatmap const& heatmap, char const* file_name)
+{
+	size_t length = std::strlen(file_name);
+	bool ppm = length >= 4 && std::strcmp(file_name + length - 4, ".ppm") == 0;
+
+	return ppm ? heatmap.WritePpm(file_name) : heatmap.WriteCsv(file_name);
+}
+
+
+//	run <frames>          advance every instance
+//	same / changed / inc / dec   keep the addresses that compare so against the last filter in every instance
+//	eq / ne / gt / lt <value>    keep the addresses that compare so against a value in every instance
+//	list [n]              candidates with their values in the first instances
+//	reset                 every address is a candidate again
+//	heat <file>           memory accesses of instance 0 (.ppm image, CSV otherwise)
+//	q                     quit
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " <ROM> [Instances] [Cycles per frame] [Threads]\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	Session session;
+	session.count = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 1000;
+	session.cycles = argc > 3 ? std::atoi(argv[3]) : 10;
+	unsigned int threads = argc > 4 ? std::atoi(argv[4]) : 0;
+
+	if (session.count == 0 || session.cycles == 0)
+	{
+		std::cerr << "Instances and cycles must be at least 1\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	session.instances.reset(new Instance[session.count]);
+	session.previous.resize(session.count * MEMORY_SIZE);
+
+	if (!session.instances[0].chip8.open_ROM(argv[1]))
+	{
+		std::cerr << "Could not load ROM: " << argv[1] << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	for (size_t i = 0; i < session.count; ++i)
+	{
+		Instance& instance = session.instances[i];
+
+		if (i > 0)
+		{
+			instance.chip8 = session.instances[0].chip8;
+		}
+
+		instance.chip8.Seed(i);
+		instance.keyState = (i + 1) * 0x9E3779B97F4A7C15ull;
+	}
+
+	session.instances[0].chip8.SetHeatmap(&session.heatmap);
+	Snapshot(session);
+
+	WorkerPool pool(threads);
+	std::cout << session.count << " instances on " << pool.ThreadCount() << " threads\n";
+
+	std::string line;
+
+	while (std::cout << "(search " << session.search.Count() << ") " << std::flush, std::getline(std::cin, line))
+	{
+		std::istringstream in(line);
+		std::string command;
+		in >> command;
+
+		auto start = std::chrono::steady_clock::now();
+
+		if (command == "q")
+		{
+			break;
+		}
+		else if (command == "run")
+		{
+			if (!(in >> session.frames))
+			{
+				session.frames = 1;
+			}
+
+			pool.ParallelFor(session.count, RunInstance, &session);
+		}
+		else if (command == "same" || command == "changed" || command == "inc" || command == "dec")
+		{
+			Filter(session, command == "same" ? SEARCH_EQUAL : command == "changed" ? SEARCH_CHANGED
+				: command == "inc" ? SEARCH_INCREASED : SEARCH_DECREASED);
+		}
+		else if (command == "eq" || command == "ne" || command == "gt" || command == "lt")
+		{
+			unsigned int value;
+
+			if (!(in >> value))
+			{
+				std::cout << "value missing\n";
+				continue;
+			}
+
+			FilterValue(session, command == "eq" ? SEARCH_EQUAL : command == "ne" ? SEARCH_CHANGED
+				: command == "gt" ? SEARCH_INCREASED : SEARCH_DECREASED, static_cast<uint8_t>(value));
+		}
+		else if (command == "list")
+		{
+			unsigned int max;
+			List(session, (in >> max) ? max : default_listed);
+			continue;
+		}
+		else if (command == "reset")
+		{
+			session.search.Reset();
+			Snapshot(session);
+		}
+		else if (command == "heat")
+		{
+			std::string file;
+
+			if (!(in >> file) || !WriteHeatmap(session.heatmap, file.c_str()))
+			{
+				std::cout << "could not write heatmap\n";
+			}
+
+			continue;
+		}
+		else
+		{
+			if (!command.empty())
+			{
+				std::cout << "unknown command: " << command << "\n";
+			}
+
+			continue;
+		}
+
+		double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		std::cout << command << ": " << ms << " ms\n";
+	}
+
+	return 0;
+}
@@ -0,0 +1,112 @@
+// Records frames faster than the writer encodes them and checks that every frame reads back unchanged
+#include "../Chip8_Emulator_Project/chip8.h"
+#include "../Chip8_Emulator_Project/recorder.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+
+/*
+- Every frame is a new random display, so the writer has a full delta to encode for each one while capture
+  only packs and copies: the queue fills within a few hundred frames and Capture has to wait for the writer
+- A dropped frame would be written as a repeat of the one before it, so comparing every decoded frame with the
+  captured one catches drops as well as encoding mistakes
+- Exits with 1 on any mismatch, on a dropped frame or when a second Open of an open recorder is not refused
+*/
+
+//Several times the queue, so the producer is ahead of the writer for most of the run
+const unsigned int test_frames = 4000;
+
+
+//xorshift64*
+static uint64_t NextRandom(uint64_t& state)
+{
+	state ^= state >> 12u;
+	state ^= state << 25u;
+	state ^= state >> 27u;
+	return state * 0x2545F4914F6CDD1Dull;
+}
+
+int main(int argc, char** argv)
+{
+	char const* fileName = argc > 1 ? argv[1] : "recorder_test.c8rv";
+
+	Chip8 chip8;
+	Recorder recorder;
+
+	if (!recorder.Open(fileName))
+	{
+		std::cerr << "Could not create " << fileName << "\n";
+		return EXIT_FAILURE;
+	}
+
+	int failures = 0;
+
+	if (recorder.Open(fileName))
+	{
+		std::cerr << "A second Open of an open recorder was not refused\n";
+		++failures;
+	}
+
+	std::vector<uint8_t> captured(test_frames * VIDEO_PACKED_SIZE);
+	uint64_t state = 0x9E3779B97F4A7C15ull;
+
+	for (unsigned int frame = 0; frame < test_frames; ++frame)
+	{
+		//Every 8th frame repeats the one before, so RECORD_SAME_FRAME is covered as well
+		if (frame % 8 != 7)
+		{
+			for (uint32_t& pixel : chip8.video)
+			{
+				pixel = NextRandom(state) >> 63u ? 0xFFFFFFFFu : 0u;
+			}
+		}
+
+		chip8.PackVideo(&captured[frame * VIDEO_PACKED_SIZE]);
+		recorder.Capture(chip8);
+	}
+
+	recorder.Close();
+
+	if (uint64_t dropped = recorder.Dropped())
+	{
+		std::cerr << dropped << " frames dropped\n";
+		++failures;
+	}
+
+	RecordingReader reader;
+
+	if (!reader.Open(fileName))
+	{
+		std::cerr << "Could not read back " << fileName << "\n";
+		return EXIT_FAILURE;
+	}
+
+	uint8_t packed[VIDEO_PACKED_SIZE];
+	unsigned int decoded = 0;
+	unsigned int mismatched = 0;
+
+	while (reader.NextFrame(packed))
+	{
+		if (decoded < test_frames && memcmp(packed, &captured[decoded * VIDEO_PACKED_SIZE], VIDEO_PACKED_SIZE) != 0)
+		{
+			++mismatched;
+		}
+
+		++decoded;
+	}
+
+	if (decoded != test_frames || mismatched)
+	{
+		std::cerr << decoded << " of " << test_frames << " frames decoded, " << mismatched << " differ\n";
+		++failures;
+	}
+
+	std::remove(fileName);
+
+	std::cout << test_frames << " frames recorded and read back, " << failures << " failures\n";
+
+	return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
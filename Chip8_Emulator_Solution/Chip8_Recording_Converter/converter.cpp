@@ -0,0 +1,111 @@
+// Converts a recording made with "-record" into raw RGBA frames or a PPM/PNG sequence, optionally scaled
+#include "../Chip8_Emulator_Project/recorder.h"
+#include "../Chip8_Emulator_Project/scaler.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+
+//Raw output: every frame appended as scaled RGBA pixels (R, G, B, A bytes)
+static bool WriteRGBA(FILE* out, std::vector<uint8_t> const& rgba)
+{
+	return fwrite(rgba.data(), 1, rgba.size(), out) == rgba.size();
+}
+
+
+int main(int argc, char** argv)
+{
+	ScaleOptions scaling;
+	scaling.scale = 1;
+	int first = 1;
+
+	for (; first + 1 < argc && argv[first][0] == '-'; first += 2)
+	{
+		if (std::strcmp(argv[first], "-scale") == 0 && std::atoi(argv[first + 1]) > 0)
+		{
+			scaling.scale = std::atoi(argv[first + 1]);
+		}
+		else if (std::strcmp(argv[first], "-filter") != 0 || !ParseScaleFilter(argv[first + 1], scaling.filter))
+		{
+			break;
+		}
+	}
+
+	char const* format = first < argc ? argv[first] : "";
+
+	if (argc - first != 3 || (std::strcmp(format, "rgba") != 0 && std::strcmp(format, "ppm") != 0 && std::strcmp(format, "png") != 0))
+	{
+		std::cerr << "Usage: " << argv[0] << " [-scale <N>] [-filter nearest|scanlines|grid] rgba <Recording> <Output File>\n"
+			<< "       " << argv[0] << " [-scale <N>] [-filter nearest|scanlines|grid] ppm|png <Recording> <Output Prefix>\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	bool rgba = std::strcmp(format, "rgba") == 0;
+	bool png = std::strcmp(format, "png") == 0;
+	char const* recordingFilename = argv[first + 1];
+	char const* output = argv[first + 2];
+
+	RecordingReader reader;
+
+	if (!reader.Open(recordingFilename))
+	{
+		std::cerr << "Not a CHIP-8 recording: " << recordingFilename << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	FILE* out = nullptr;
+
+	if (rgba)
+	{
+		out = fopen(output, "wb");
+
+		if (!out)
+		{
+			std::cerr << "Could not open output file: " << output << "\n";
+			std::exit(EXIT_FAILURE);
+		}
+	}
+
+	uint8_t packed[VIDEO_PACKED_SIZE];
+	unsigned int frames = 0;
+
+	unsigned int width = ScaledWidth(scaling);
+	unsigned int height = ScaledHeight(scaling);
+	std::vector<uint8_t> image(static_cast<size_t>(width) * height * 4);
+
+	while (reader.NextFrame(packed))
+	{
+		bool ok;
+		ScaleDisplay(packed, scaling, image.data(), width * 4);
+
+		if (rgba)
+		{
+			ok = WriteRGBA(out, image);
+		}
+		else
+		{
+			char file_name[1024];
+			snprintf(file_name, sizeof(file_name), png ? "%s%06u.png" : "%s%06u.ppm", output, frames);
+			ok = png ? WritePng(file_name, image.data(), width, height, width * 4) : WritePpm(file_name, image.data(), width, height, width * 4);
+		}
+
+		if (!ok)
+		{
+			std::cerr << "Failed writing frame " << frames << "\n";
+			std::exit(EXIT_FAILURE);
+		}
+
+		++frames;
+	}
+
+	if (out)
+	{
+		fclose(out);
+	}
+
+	std::cout << frames << " frames converted\n";
+
+	return 0;
+}
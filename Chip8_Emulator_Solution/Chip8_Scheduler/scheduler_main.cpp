@@ -0,0 +1,148 @@
+// Runs thousands of interactive sessions on a few worker threads and reports how well they keep their 60Hz frames
+#include "../Chip8_Emulator_Project/chip8.h"
+#include "../Chip8_Emulator_Project/session_scheduler.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+
+/*
+- Every session runs the same ROM with its own Cxkk seed, and gets new random keys every key_period,
+  like players pressing keys
+- Once a second prints the frames run against the frames due, the misses and skips and the response time
+  (release of a frame to its end); at the end the fewest and most frames any one session got
+- Exits with 1 when more than the allowed share of frames missed their deadline
+*/
+
+//Sessions get new keys this often
+const std::chrono::milliseconds key_period(100);
+//Missed frames tolerated before the run counts as failed
+const double allowed_miss_ratio = 0.01;
+
+
+//xorshift64*, about one key in eight down
+static uint16_t NextKeys(uint64_t& state)
+{
+	state ^= state >> 12u;
+	state ^= state << 25u;
+	state ^= state >> 27u;
+	uint64_t value = state * 0x2545F4914F6CDD1Dull;
+
+	return static_cast<uint16_t>(value & (value >> 16u) & (value >> 32u));
+}
+
+static double Milliseconds(uint64_t nanoseconds)
+{
+	return nanoseconds / 1e6;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " <ROM> [Sessions] [Cycles per frame] [Seconds] [Threads]\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	int sessionCount = argc > 2 ? std::atoi(argv[2]) : 1000;
+	int cycles = argc > 3 ? std::atoi(argv[3]) : 10;
+	int seconds = argc > 4 ? std::atoi(argv[4]) : 10;
+	int threads = argc > 5 ? std::atoi(argv[5]) : 0;
+
+	if (sessionCount <= 0 || cycles <= 0 || seconds <= 0 || threads < 0)
+	{
+		std::cerr << "Sessions, cycles and seconds must be at least 1\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	Chip8 machine;
+
+	if (!machine.open_ROM(argv[1]))
+	{
+		std::cerr << "Could not load ROM: " << argv[1] << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	SessionScheduler scheduler(threads);
+
+	for (int i = 0; i < sessionCount; ++i)
+	{
+		machine.Seed(i);
+		scheduler.AddSession(machine, cycles);
+	}
+
+	std::cout << sessionCount << " sessions, " << cycles << " cycles per frame, " << scheduler.ThreadCount() << " threads\n";
+
+	std::vector<uint64_t> keyStates(sessionCount);
+
+	for (int i = 0; i < sessionCount; ++i)
+	{
+		keyStates[i] = 0x9E3779B97F4A7C15ull * (i + 1);
+	}
+
+	SchedulerStats const& stats = scheduler.Stats();
+	auto start = std::chrono::steady_clock::now();
+	auto nextKeys = start;
+	auto nextReport = start + std::chrono::seconds(1);
+	uint64_t reportedFrames = 0;
+
+	scheduler.Start();
+
+	for (int second = 0; second < seconds;)
+	{
+		std::this_thread::sleep_until(std::min(nextKeys, nextReport));
+		auto now = std::chrono::steady_clock::now();
+
+		if (now >= nextKeys)
+		{
+			for (int i = 0; i < sessionCount; ++i)
+			{
+				scheduler.SetKeys(i, NextKeys(keyStates[i]));
+			}
+
+			nextKeys += key_period;
+		}
+
+		if (now >= nextReport)
+		{
+			uint64_t frames = stats.frames.Get();
+
+			std::cout << std::fixed << std::setprecision(2)
+				<< "frames/s " << frames - reportedFrames << " of " << sessionCount * 60
+				<< "  missed " << stats.missed.Get() << "  skipped " << stats.skipped.Get()
+				<< "  stolen " << stats.stolen.Get()
+				<< "  response p50 " << Milliseconds(stats.response_time.Quantile(0.5))
+				<< " ms p99 " << Milliseconds(stats.response_time.Quantile(0.99))
+				<< " ms p99.9 " << Milliseconds(stats.response_time.Quantile(0.999)) << " ms\n";
+
+			reportedFrames = frames;
+			nextReport += std::chrono::seconds(1);
+			++second;
+		}
+	}
+
+	scheduler.Stop();
+
+	//Fairness: with every session on the same clock, the frame counts should be within a frame or two
+	uint64_t fewest = ~0ull;
+	uint64_t most = 0;
+
+	for (int i = 0; i < sessionCount; ++i)
+	{
+		SessionStats session = scheduler.GetSessionStats(i);
+		fewest = std::min(fewest, session.frames);
+		most = std::max(most, session.frames);
+	}
+
+	uint64_t frames = stats.frames.Get();
+	double missRatio = frames ? static_cast<double>(stats.missed.Get()) / frames : 0.0;
+
+	std::cout << "frames " << frames << "  per session " << fewest << " to " << most
+		<< "  missed " << std::setprecision(3) << missRatio * 100.0 << "%  skipped " << stats.skipped.Get() << "\n";
+
+	return missRatio > allowed_miss_ratio ? EXIT_FAILURE : EXIT_SUCCESS;
+}
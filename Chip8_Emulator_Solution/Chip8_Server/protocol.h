@@ -0,0 +1,78 @@
+#pragma once
+#include "../Chip8_Emulator_Project/chip8.h"
+#include <atomic>
+#include <cstdint>
+
+/*
+- The server listens on a UNIX domain socket and answers fixed size binary commands
+- Every instance publishes its display (1 bit per pixel) and registers into one shared memory region
+- Clients map the region read only and read an instance without any copy through the socket
+- Each slot is guarded by a sequence counter: odd while the server writes it, even when stable
+*/
+
+const char* const SERVER_SOCKET_PATH = "/tmp/chip8_server.sock";
+const char* const SERVER_SHARED_MEMORY_NAME = "/chip8_server_instances";
+const unsigned int SERVER_MAX_INSTANCES = 1024;
+const unsigned int SERVER_PATH_SIZE = 256;
+//Most work one RUN command may ask for: one thread serves every client, a longer run would stall the others
+//(10 seconds of frames, about 6M instructions at the largest cycle count)
+const unsigned int SERVER_MAX_RUN_FRAMES = 600;
+const unsigned int SERVER_MAX_RUN_CYCLES = 10000;
+
+enum ServerCommandType : uint32_t
+{
+	COMMAND_CREATE = 1,   //Create an instance seeded with seed, reply.instance is its slot
+	COMMAND_DESTROY,      //Free the slot
+	COMMAND_LOAD_ROM,     //Reset the instance, seed it with seed and load path (drops the snapshot of the previous ROM)
+	COMMAND_SET_KEYS,     //keys bit n = CHIP-8 key n is down
+	COMMAND_RUN,          //Run frames frames of cycles instructions each, at most SERVER_MAX_RUN_FRAMES/CYCLES
+	COMMAND_SNAPSHOT,     //Save the whole machine on the server side
+	COMMAND_RESTORE,      //Go back to the last snapshot
+	COMMAND_PING          //No work, used to measure the command path
+};
+
+enum ServerStatus : uint32_t
+{
+	STATUS_OK = 0,
+	STATUS_BAD_COMMAND,
+	STATUS_BAD_INSTANCE,
+	STATUS_FULL,
+	STATUS_ROM_ERROR,
+	STATUS_NO_SNAPSHOT,
+	STATUS_BAD_REQUEST    //Arguments out of range (RUN over SERVER_MAX_RUN_FRAMES or SERVER_MAX_RUN_CYCLES)
+};
+
+struct ServerCommand
+{
+	uint32_t type;
+	uint32_t instance;
+	uint32_t frames;
+	uint32_t cycles;
+	uint16_t keys;
+	//Random numbers (Cxkk) of the instance, so parallel runs are reproducible and still differ
+	uint64_t seed;
+	char path[SERVER_PATH_SIZE];
+};
+
+struct ServerReply
+{
+	uint32_t status;
+	uint32_t instance;
+	//Sequence of the instance slot after the command, clients can wait on it
+	uint32_t sequence;
+};
+
+struct SharedInstance
+{
+	std::atomic<uint32_t> sequence;
+	uint32_t in_use;
+	uint64_t frame_count;
+	Chip8Registers registers;
+	uint8_t video[VIDEO_PACKED_SIZE];
+};
+
+struct SharedRegion
+{
+	uint32_t instance_count;
+	SharedInstance instances[SERVER_MAX_INSTANCES];
+};
@@ -0,0 +1,294 @@
+// Hosts many Chip8 instances for local processes (bots, test drivers) without SDL
+#include "protocol.h"
+#include "../Chip8_Emulator_Project/rom_cache.h"
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <memory>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <vector>
+
+
+//Instructions per frame when a RUN command does not say
+const unsigned int default_cycles_per_frame = 10;
+
+
+struct Instance
+{
+	//The ROM cache reference open_ROM took is held until the instance is destroyed or loads another ROM
+	~Instance()
+	{
+		ReleaseRomImage(chip8.Image());
+	}
+
+	Chip8 chip8;
+	//Always of the loaded ROM, so it shares chip8's image reference
+	std::unique_ptr<Chip8> snapshot;
+	//Frames run since the ROM was loaded, published with the rest of the slot
+	uint64_t frame_count{};
+};
+
+static SharedRegion* shared = nullptr;
+static std::unique_ptr<Instance> instances[SERVER_MAX_INSTANCES];
+
+
+//Write the instance into its shared memory slot (sequence is odd during the write)
+static void Publish(uint32_t id)
+{
+	SharedInstance& slot = shared->instances[id];
+	uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+
+	slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	if (instances[id])
+	{
+		slot.in_use = 1;
+		slot.frame_count = instances[id]->frame_count;
+		instances[id]->chip8.GetRegisters(slot.registers);
+		instances[id]->chip8.PackVideo(slot.video);
+	}
+	else
+	{
+		slot.in_use = 0;
+		slot.frame_count = 0;
+	}
+
+	slot.sequence.store(sequence + 2, std::memory_order_release);
+}
+
+static ServerReply Execute(ServerCommand const& command)
+{
+	ServerReply reply{ STATUS_OK, command.instance, 0 };
+
+	if (command.type == COMMAND_PING)
+	{
+		return reply;
+	}
+
+	if (command.type == COMMAND_CREATE)
+	{
+		uint32_t id = 0;
+
+		while (id < SERVER_MAX_INSTANCES && instances[id])
+		{
+			++id;
+		}
+
+		if (id == SERVER_MAX_INSTANCES)
+		{
+			reply.status = STATUS_FULL;
+			return reply;
+		}
+
+		instances[id].reset(new Instance);
+		instances[id]->chip8.Seed(command.seed);
+
+		if (id >= shared->instance_count)
+		{
+			shared->instance_count = id + 1;
+		}
+
+		reply.instance = id;
+		Publish(id);
+		reply.sequence = shared->instances[id].sequence.load(std::memory_order_relaxed);
+		return reply;
+	}
+
+	if (command.instance >= SERVER_MAX_INSTANCES || !instances[command.instance])
+	{
+		reply.status = STATUS_BAD_INSTANCE;
+		return reply;
+	}
+
+	Instance& instance = *instances[command.instance];
+	SharedInstance& slot = shared->instances[command.instance];
+
+	switch (command.type)
+	{
+	case COMMAND_DESTROY:
+	{
+		instances[command.instance].reset();
+	} break;
+
+	case COMMAND_LOAD_ROM:
+	{
+		char path[SERVER_PATH_SIZE + 1]{};
+		memcpy(path, command.path, SERVER_PATH_SIZE);
+
+		Chip8 loaded;
+
+		if (!loaded.open_ROM(path))
+		{
+			reply.status = STATUS_ROM_ERROR;
+			return reply;
+		}
+
+		loaded.Seed(command.seed);
+
+		//A snapshot of the previous ROM would point at the image released here
+		RomImage const* previous = instance.chip8.Image();
+		instance.chip8 = loaded;
+		instance.snapshot.reset();
+		instance.frame_count = 0;
+		ReleaseRomImage(previous);
+	} break;
+
+	case COMMAND_SET_KEYS:
+	{
+		instance.chip8.keypad = command.keys;
+	} break;
+
+	case COMMAND_RUN:
+	{
+		unsigned int cycles = command.cycles ? command.cycles : default_cycles_per_frame;
+
+		if (command.frames > SERVER_MAX_RUN_FRAMES || cycles > SERVER_MAX_RUN_CYCLES)
+		{
+			reply.status = STATUS_BAD_REQUEST;
+			return reply;
+		}
+
+		for (uint32_t frame = 0; frame < command.frames; ++frame)
+		{
+			instance.chip8.RunFrame(cycles);
+		}
+
+		instance.frame_count += command.frames;
+	} break;
+
+	case COMMAND_SNAPSHOT:
+	{
+		instance.snapshot.reset(new Chip8(instance.chip8));
+	} break;
+
+	case COMMAND_RESTORE:
+	{
+		if (!instance.snapshot)
+		{
+			reply.status = STATUS_NO_SNAPSHOT;
+			return reply;
+		}
+
+		instance.chip8 = *instance.snapshot;
+	} break;
+
+	default:
+	{
+		reply.status = STATUS_BAD_COMMAND;
+		return reply;
+	}
+	}
+
+	Publish(command.instance);
+	reply.sequence = slot.sequence.load(std::memory_order_relaxed);
+
+	return reply;
+}
+
+
+int main(int argc, char** argv)
+{
+	char const* socket_path = argc > 1 ? argv[1] : SERVER_SOCKET_PATH;
+
+	//Shared memory holding every instance slot
+	shm_unlink(SERVER_SHARED_MEMORY_NAME);
+	int shared_fd = shm_open(SERVER_SHARED_MEMORY_NAME, O_CREAT | O_RDWR, 0644);
+
+	if (shared_fd < 0 || ftruncate(shared_fd, sizeof(SharedRegion)) != 0)
+	{
+		std::cerr << "Could not create shared memory " << SERVER_SHARED_MEMORY_NAME << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	void* mapping = mmap(nullptr, sizeof(SharedRegion), PROT_READ | PROT_WRITE, MAP_SHARED, shared_fd, 0);
+	close(shared_fd);
+
+	if (mapping == MAP_FAILED)
+	{
+		std::cerr << "Could not map shared memory\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	//ftruncate zero fills, which is a valid empty region
+	shared = static_cast<SharedRegion*>(mapping);
+
+	int listener = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, socket_path, sizeof(address.sun_path) - 1);
+	unlink(socket_path);
+
+	if (listener < 0
+		|| bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0
+		|| listen(listener, 64) != 0)
+	{
+		std::cerr << "Could not listen on " << socket_path << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	std::cout << "Listening on " << socket_path << ", shared memory " << SERVER_SHARED_MEMORY_NAME << "\n";
+
+	//One thread serves every client, each command is a single packet in and a single packet out
+	std::vector<pollfd> fds;
+	fds.push_back({ listener, POLLIN, 0 });
+
+	while (true)
+	{
+		if (poll(fds.data(), fds.size(), -1) < 0)
+		{
+			continue;
+		}
+
+		if (fds[0].revents & POLLIN)
+		{
+			int client = accept(listener, nullptr, nullptr);
+
+			if (client >= 0)
+			{
+				fds.push_back({ client, POLLIN, 0 });
+			}
+		}
+
+		for (size_t i = 1; i < fds.size(); )
+		{
+			if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+			{
+				++i;
+				continue;
+			}
+
+			ServerCommand command;
+			ssize_t size = recv(fds[i].fd, &command, sizeof(command), 0);
+
+			if (size <= 0)
+			{
+				close(fds[i].fd);
+				fds.erase(fds.begin() + i);
+				continue;
+			}
+
+			ServerReply reply;
+
+			if (size != sizeof(command))
+			{
+				reply = ServerReply{ STATUS_BAD_COMMAND, 0, 0 };
+			}
+			else
+			{
+				reply = Execute(command);
+			}
+
+			send(fds[i].fd, &reply, sizeof(reply), MSG_NOSIGNAL);
+			++i;
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,85 @@
+// Measures the server command path: round trip latency and command throughput
+#include "../Chip8_Server_Client/client.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+
+//Time every command, then print percentiles in microseconds
+template <typename Command>
+static void Measure(char const* name, unsigned int count, Command command)
+{
+	//No samples, no percentiles
+	if (count == 0)
+	{
+		return;
+	}
+
+	std::vector<double> samples;
+	samples.reserve(count);
+
+	auto start = std::chrono::high_resolution_clock::now();
+
+	for (unsigned int i = 0; i < count; ++i)
+	{
+		auto before = std::chrono::high_resolution_clock::now();
+		command();
+		auto after = std::chrono::high_resolution_clock::now();
+
+		samples.push_back(std::chrono::duration<double, std::micro>(after - before).count());
+	}
+
+	double total = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+	std::sort(samples.begin(), samples.end());
+
+	std::cout << name
+		<< ": p50 " << samples[count / 2] << "us"
+		<< "  p99 " << samples[count * 99 / 100] << "us"
+		<< "  max " << samples.back() << "us"
+		<< "  " << static_cast<unsigned long>(count / total) << " commands/s\n";
+}
+
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cerr << "Usage: " << argv[0] << " <ROM> [Commands] [Socket]\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	char const* romFilename = argv[1];
+	int count = argc > 2 ? std::atoi(argv[2]) : 100000;
+	char const* socketPath = argc > 3 ? argv[3] : SERVER_SOCKET_PATH;
+
+	if (count < 2)
+	{
+		std::cerr << "Commands must be at least 2\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	ServerClient client;
+	uint32_t instance;
+
+	if (!client.Connect(socketPath) || !client.Create(instance, 0) || !client.LoadROM(instance, romFilename, 0))
+	{
+		std::cerr << "Could not set up an instance on " << socketPath << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	Chip8Registers registers;
+	uint8_t video[VIDEO_PACKED_SIZE];
+
+	Measure("ping", count, [&] { client.Ping(); });
+	Measure("set keys", count, [&] { client.SetKeys(instance, 0x0001); });
+	Measure("run 1 frame", count, [&] { client.Run(instance, 1); });
+	Measure("run 1 frame + read", count, [&] { client.Run(instance, 1); client.Read(instance, registers, video); });
+	Measure("snapshot + restore", count / 2, [&] { client.Snapshot(instance); client.Restore(instance); });
+
+	client.Destroy(instance);
+
+	return 0;
+}
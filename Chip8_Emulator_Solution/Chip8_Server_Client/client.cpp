@@ -0,0 +1,203 @@
+#include "client.h"
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+
+ServerClient::~ServerClient()
+{
+	if (socket_fd >= 0)
+	{
+		close(socket_fd);
+	}
+
+	if (shared)
+	{
+		munmap(const_cast<SharedRegion*>(shared), sizeof(SharedRegion));
+	}
+}
+
+bool ServerClient::Connect(char const* socket_path)
+{
+	socket_fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	strncpy(address.sun_path, socket_path, sizeof(address.sun_path) - 1);
+
+	if (socket_fd < 0 || connect(socket_fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0)
+	{
+		return false;
+	}
+
+	int shared_fd = shm_open(SERVER_SHARED_MEMORY_NAME, O_RDONLY, 0);
+
+	if (shared_fd < 0)
+	{
+		return false;
+	}
+
+	void* mapping = mmap(nullptr, sizeof(SharedRegion), PROT_READ, MAP_SHARED, shared_fd, 0);
+	close(shared_fd);
+
+	if (mapping == MAP_FAILED)
+	{
+		return false;
+	}
+
+	shared = static_cast<SharedRegion const*>(mapping);
+
+	return true;
+}
+
+bool ServerClient::Send(ServerCommand const& command, ServerReply& reply)
+{
+	if (send(socket_fd, &command, sizeof(command), MSG_NOSIGNAL) != sizeof(command))
+	{
+		return false;
+	}
+
+	return recv(socket_fd, &reply, sizeof(reply), 0) == sizeof(reply);
+}
+
+bool ServerClient::Simple(uint32_t type, uint32_t instance)
+{
+	ServerCommand command{};
+	command.type = type;
+	command.instance = instance;
+
+	ServerReply reply;
+
+	return Send(command, reply) && reply.status == STATUS_OK;
+}
+
+bool ServerClient::Create(uint32_t& instance, uint64_t seed)
+{
+	ServerCommand command{};
+	command.type = COMMAND_CREATE;
+	command.seed = seed;
+
+	ServerReply reply;
+
+	if (!Send(command, reply) || reply.status != STATUS_OK)
+	{
+		return false;
+	}
+
+	instance = reply.instance;
+
+	return true;
+}
+
+bool ServerClient::Destroy(uint32_t instance)
+{
+	return Simple(COMMAND_DESTROY, instance);
+}
+
+bool ServerClient::LoadROM(uint32_t instance, char const* path, uint64_t seed)
+{
+	ServerCommand command{};
+	command.type = COMMAND_LOAD_ROM;
+	command.instance = instance;
+	command.seed = seed;
+
+	char resolved[PATH_MAX];
+
+	if (!realpath(path, resolved) || strlen(resolved) >= SERVER_PATH_SIZE)
+	{
+		return false;
+	}
+
+	memcpy(command.path, resolved, strlen(resolved) + 1);
+
+	ServerReply reply;
+
+	return Send(command, reply) && reply.status == STATUS_OK;
+}
+
+bool ServerClient::SetKeys(uint32_t instance, uint16_t keys)
+{
+	ServerCommand command{};
+	command.type = COMMAND_SET_KEYS;
+	command.instance = instance;
+	command.keys = keys;
+
+	ServerReply reply;
+
+	return Send(command, reply) && reply.status == STATUS_OK;
+}
+
+bool ServerClient::Run(uint32_t instance, uint32_t frames, uint32_t cycles)
+{
+	ServerCommand command{};
+	command.type = COMMAND_RUN;
+	command.instance = instance;
+	command.frames = frames;
+	command.cycles = cycles;
+
+	ServerReply reply;
+
+	return Send(command, reply) && reply.status == STATUS_OK;
+}
+
+bool ServerClient::Snapshot(uint32_t instance)
+{
+	return Simple(COMMAND_SNAPSHOT, instance);
+}
+
+bool ServerClient::Restore(uint32_t instance)
+{
+	return Simple(COMMAND_RESTORE, instance);
+}
+
+bool ServerClient::Ping()
+{
+	return Simple(COMMAND_PING, 0);
+}
+
+SharedInstance const* ServerClient::Instance(uint32_t instance) const
+{
+	if (!shared || instance >= SERVER_MAX_INSTANCES || instance >= shared->instance_count)
+	{
+		return nullptr;
+	}
+
+	return &shared->instances[instance];
+}
+
+bool ServerClient::Read(uint32_t instance, Chip8Registers& registers, uint8_t* video) const
+{
+	SharedInstance const* found = Instance(instance);
+
+	if (!found)
+	{
+		return false;
+	}
+
+	SharedInstance const& slot = *found;
+
+	while (true)
+	{
+		uint32_t before = slot.sequence.load(std::memory_order_acquire);
+
+		if (before & 1u)
+		{
+			continue;
+		}
+
+		registers = slot.registers;
+		memcpy(video, slot.video, VIDEO_PACKED_SIZE);
+
+		std::atomic_thread_fence(std::memory_order_acquire);
+
+		if (slot.sequence.load(std::memory_order_relaxed) == before)
+		{
+			return true;
+		}
+	}
+}
@@ -0,0 +1,35 @@
+#pragma once
+#include "../Chip8_Server/protocol.h"
+#include <cstdint>
+
+
+class ServerClient
+{
+public:
+	~ServerClient();
+	bool Connect(char const* socket_path = SERVER_SOCKET_PATH);
+	//Sends one command and waits for the reply, false if the connection failed
+	bool Send(ServerCommand const& command, ServerReply& reply);
+
+	//seed: random numbers (Cxkk) of the instance
+	bool Create(uint32_t& instance, uint64_t seed);
+	bool Destroy(uint32_t instance);
+	//The path is sent resolved (the server has its own working directory), false if it is SERVER_PATH_SIZE or longer
+	bool LoadROM(uint32_t instance, char const* path, uint64_t seed);
+	bool SetKeys(uint32_t instance, uint16_t keys);
+	bool Run(uint32_t instance, uint32_t frames, uint32_t cycles = 0);
+	bool Snapshot(uint32_t instance);
+	bool Restore(uint32_t instance);
+	bool Ping();
+
+	//Direct view of a slot in shared memory, the server may be writing it. nullptr past the slots the server uses
+	SharedInstance const* Instance(uint32_t instance) const;
+	//Consistent copy of a slot (retries while the server is writing it), false past the slots the server uses
+	bool Read(uint32_t instance, Chip8Registers& registers, uint8_t* video) const;
+
+private:
+	bool Simple(uint32_t type, uint32_t instance);
+
+	int socket_fd{ -1 };
+	SharedRegion const* shared{};
+};
@@ -0,0 +1,75 @@
+// Small command line client: loads a ROM into a new server instance, runs it and prints the display
+#include "client.h"
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+
+
+int main(int argc, char** argv)
+{
+	if (argc < 3)
+	{
+		std::cerr << "Usage: " << argv[0] << " <ROM> <Frames> [Keys] [Socket] [Seed]\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	char const* romFilename = argv[1];
+	uint32_t frames = std::atoi(argv[2]);
+	uint16_t keys = argc > 3 ? std::strtoul(argv[3], nullptr, 16) : 0;
+	char const* socketPath = argc > 4 ? argv[4] : SERVER_SOCKET_PATH;
+	uint64_t seed = argc > 5 ? std::strtoull(argv[5], nullptr, 10) : 0;
+
+	ServerClient client;
+
+	if (!client.Connect(socketPath))
+	{
+		std::cerr << "Could not connect to " << socketPath << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	uint32_t instance;
+
+	if (!client.Create(instance, seed) || !client.LoadROM(instance, romFilename, seed))
+	{
+		std::cerr << "Could not load " << romFilename << "\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	client.SetKeys(instance, keys);
+
+	//The server runs at most SERVER_MAX_RUN_FRAMES per command
+	for (uint32_t run = 0; run < frames; run += SERVER_MAX_RUN_FRAMES)
+	{
+		if (!client.Run(instance, std::min(frames - run, SERVER_MAX_RUN_FRAMES)))
+		{
+			std::cerr << "Could not run instance " << instance << "\n";
+			std::exit(EXIT_FAILURE);
+		}
+	}
+
+	Chip8Registers registers;
+	uint8_t video[VIDEO_PACKED_SIZE];
+
+	if (!client.Read(instance, registers, video))
+	{
+		std::cerr << "Instance " << instance << " is not in shared memory\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	for (unsigned int y = 0; y < VIDEO_HEIGHT; ++y)
+	{
+		for (unsigned int x = 0; x < VIDEO_WIDTH; ++x)
+		{
+			bool on = video[y * VIDEO_ROW_BYTES + x / 8] & (0x80u >> (x % 8));
+			std::cout << (on ? '#' : '.');
+		}
+
+		std::cout << "\n";
+	}
+
+	std::cout << std::hex << "PC " << registers.program_counter << "  I " << registers.index_register << "\n";
+
+	client.Destroy(instance);
+
+	return 0;
+}
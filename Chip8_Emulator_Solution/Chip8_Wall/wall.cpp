@@ -0,0 +1,161 @@
+// Shows many Chip8 instances in one window, each instance is one tile of a single texture
+#include "../Chip8_Emulator_Project/chip8.h"
+#include "../Chip8_Emulator_Project/input.h"
+#include "../Chip8_Emulator_Project/platform.h"
+#include "../Chip8_Emulator_Project/worker_pool.h"
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+
+const std::chrono::nanoseconds frame_time(1000000000 / 60);
+//How often the frame cost is printed (5 seconds)
+const unsigned int report_frames = 300;
+
+
+struct Tile
+{
+	Chip8 chip8;
+	//Packed display currently in the texture
+	uint8_t shown[VIDEO_PACKED_SIZE]{};
+	bool dirty{};
+};
+
+struct FrameJob
+{
+	Tile* tiles;
+	uint16_t keys;
+	unsigned int cycles;
+};
+
+//Runs on the worker pool: one frame of one instance, then checks whether its tile needs uploading
+static void AdvanceTile(void* context, size_t i)
+{
+	FrameJob& job = *static_cast<FrameJob*>(context);
+	Tile& tile = job.tiles[i];
+
+	tile.chip8.keypad = job.keys;
+	tile.chip8.RunFrame(job.cycles);
+
+	uint8_t packed[VIDEO_PACKED_SIZE];
+	tile.chip8.PackVideo(packed);
+
+	tile.dirty = memcmp(packed, tile.shown, VIDEO_PACKED_SIZE) != 0;
+
+	if (tile.dirty)
+	{
+		memcpy(tile.shown, packed, VIDEO_PACKED_SIZE);
+	}
+}
+
+
+int main(int argc, char** argv)
+{
+	if (argc < 6)
+	{
+		std::cerr << "Usage: " << argv[0] << " <Scale> <Columns> <Cycles per frame> <Instances> <ROM> [ROM...]\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	int scale = std::atoi(argv[1]);
+	int columns = std::atoi(argv[2]);
+	unsigned int cycles = std::atoi(argv[3]);
+	int count = std::atoi(argv[4]);
+
+	if (scale <= 0 || columns <= 0 || count <= 0)
+	{
+		std::cerr << "Scale, columns and instances must be positive\n";
+		std::exit(EXIT_FAILURE);
+	}
+
+	int rows = (count + columns - 1) / columns;
+
+	//Instances take the ROMs in turn
+	std::vector<Tile> tiles(count);
+
+	for (int i = 0; i < count; ++i)
+	{
+		char const* rom = argv[5 + i % (argc - 5)];
+
+		if (!tiles[i].chip8.open_ROM(rom))
+		{
+			std::cerr << "Could not load ROM: " << rom << "\n";
+			std::exit(EXIT_FAILURE);
+		}
+
+		//Tiles running the same ROM draw different random numbers
+		tiles[i].chip8.Seed(i);
+	}
+
+	int textureWidth = columns * VIDEO_WIDTH;
+	int textureHeight = rows * VIDEO_HEIGHT;
+	int tilePitch = sizeof(tiles[0].chip8.video[0]) * VIDEO_WIDTH;
+
+	Platform platform("CHIP-8 Wall", textureWidth * scale, textureHeight * scale, textureWidth, textureHeight);
+
+	//Start from a black texture, the tiles are only uploaded when they change from here on
+	{
+		std::vector<uint32_t> black(textureWidth * textureHeight);
+		platform.Update(black.data(), textureWidth * sizeof(uint32_t));
+	}
+
+	WorkerPool pool;
+	Input input;
+	FrameJob job{ tiles.data(), 0, cycles };
+
+	auto nextFrame = std::chrono::steady_clock::now();
+	std::chrono::nanoseconds busyTime{};
+	unsigned long long uploads = 0;
+	unsigned int frames = 0;
+
+	//Keys go to every instance
+	while (platform.PollEvents(input) != PLATFORM_QUIT)
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		job.keys = input.Keys();
+		pool.ParallelFor(tiles.size(), AdvanceTile, &job);
+
+		for (int i = 0; i < count; ++i)
+		{
+			if (tiles[i].dirty)
+			{
+				platform.UpdateRegion((i % columns) * VIDEO_WIDTH, (i / columns) * VIDEO_HEIGHT, VIDEO_WIDTH, VIDEO_HEIGHT,
+					tiles[i].chip8.video, tilePitch);
+				++uploads;
+			}
+		}
+
+		platform.Present();
+
+		busyTime += std::chrono::steady_clock::now() - start;
+
+		if (++frames == report_frames)
+		{
+			std::cout << count << " instances: " << std::chrono::duration<double, std::milli>(busyTime).count() / frames
+				<< " ms per frame, " << static_cast<double>(uploads) / frames << " tiles uploaded per frame\n";
+
+			busyTime = std::chrono::nanoseconds{};
+			uploads = 0;
+			frames = 0;
+		}
+
+		nextFrame += frame_time;
+		auto now = std::chrono::steady_clock::now();
+
+		if (now > nextFrame + frame_time)
+		{
+			//Too far behind, drop the missed frames instead of running them back to back
+			nextFrame = now;
+		}
+		else
+		{
+			std::this_thread::sleep_until(nextFrame);
+		}
+	}
+
+	return 0;
+}